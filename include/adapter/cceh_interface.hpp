@@ -12,10 +12,14 @@ namespace pmhb_ns::adapter {
 
 using cceh_map_type = cceh_ns::CCEH<varlen_kv>;
 
-struct cceh : public bench_interface<cceh_map_type> {
+struct cceh : public bench_interface<cceh_map_type, cceh> {
     using map_type = cceh_map_type;
 
-    map_type *do_open(config const &cfg, size_t kv_uulo) override {
+    void do_persistence_domain(bool eadr) {
+        cceh_ns::Allocator::eadr_ = eadr;
+    }
+
+    map_type *do_open(config const &cfg, size_t kv_uulo) {
         auto path = cfg.working_dir / "cceh";
         std::filesystem::remove_all(path);
         // auto map = map_type::open(path, pmhb_ns::MAP_STRUCTURE_SIZE, 1ul << 8);
@@ -36,7 +40,7 @@ struct cceh : public bench_interface<cceh_map_type> {
         return map;
     }
 
-    map_type *do_recover(config const &cfg) override {
+    map_type *do_recover(config const &cfg) {
         auto path = cfg.working_dir / "cceh";
         cceh_ns::Allocator::Initialize(path.c_str(),
                                        pmhb_ns::MAP_STRUCTURE_SIZE);
@@ -52,16 +56,16 @@ struct cceh : public bench_interface<cceh_map_type> {
         return map;
     }
 
-    double load_factor(map_type *map, size_t current_kv_num) override {
+    double load_factor(map_type *map, size_t current_kv_num) {
         return (double) current_kv_num * 16 / map->get_memory_usage();
     }
 
-    void do_close(map_type *cceh, config const &cfg) override {
+    void do_close(map_type *cceh, config const &cfg) {
         cceh->~map_type();
     }
 
     void do_ycsb_insert(map_type *map, context *ctx, ycsb::INSERT const &cmd,
-                        size_t pkv, bool is_load = false) override {
+                        size_t pkv, bool is_load = false) {
 #ifndef WRITE_KV
         auto k_ptr = cceh_ns::c_ptr<varlen_kv::K_TYPE>(pkv + sizeof(varlen_kv));
         auto v_ptr = cceh_ns::c_ptr<varlen_kv::V_TYPE>(
@@ -73,11 +77,11 @@ struct cceh : public bench_interface<cceh_map_type> {
         auto ret = map->Insert(cmd.key(), cmd.value(), k_ptr, v_ptr);
     }
     void do_ycsb_read(map_type *map, context *ctx,
-                      ycsb::READ const &cmd) override {
+                      ycsb::READ const &cmd) {
         auto ret = map->Get(cmd.key());
     }
     void do_ycsb_update(map_type *map, context *ctx, ycsb::UPDATE const &cmd,
-                        size_t pkv) override {
+                        size_t pkv) {
 #ifndef WRITE_KV
         auto k_ptr = cceh_ns::c_ptr<varlen_kv::K_TYPE>(pkv + sizeof(varlen_kv));
         auto v_ptr = cceh_ns::c_ptr<varlen_kv::V_TYPE>(
@@ -99,7 +103,7 @@ struct cceh : public bench_interface<cceh_map_type> {
         // }
     }
     void do_ycsb_delete(map_type *map, context *ctx,
-                        ycsb::DELETE const &cmd) override {
+                        ycsb::DELETE const &cmd) {
         map->Delete(cmd.key());
     }
     void do_ycsb_check(map_type *map, context *ctx, ycsb::CHECK const &cmd) {
@@ -10,7 +10,7 @@ namespace pmhb_ns::adapter {
 using clevel_map_type = clevel_ns::clevel_hash<std::array<char, STRING_LENGTH>,
                                                std::array<char, STRING_LENGTH>>;
 
-struct clevel : public bench_interface<clevel_map_type> {
+struct clevel : public bench_interface<clevel_map_type, clevel> {
     using map_type = clevel_map_type;
     using key_type = map_type::key_type;
     using mapped_type = map_type::mapped_type;
@@ -20,7 +20,7 @@ struct clevel : public bench_interface<clevel_map_type> {
         pmem::obj::persistent_ptr<map_type> map{};
     };
 
-    map_type *do_open(config const &cfg, size_t kv_uulo) override {
+    map_type *do_open(config const &cfg, size_t kv_uulo) {
         auto path = cfg.working_dir / "clevel";
         std::filesystem::remove_all(path);
         auto pool = pmem::obj::pool<root_type>::create(
@@ -41,7 +41,7 @@ struct clevel : public bench_interface<clevel_map_type> {
         return root->map.get();
     }
 
-    map_type *do_recover(config const &cfg) override {
+    map_type *do_recover(config const &cfg) {
         auto path = cfg.working_dir / "clevel";
         auto pool = pmem::obj::pool<root_type>::open(path, "clevel");
         auto root = pool.root();
@@ -57,16 +57,16 @@ struct clevel : public bench_interface<clevel_map_type> {
         return root->map.get();
     }
 
-    double load_factor(map_type *clevel, size_t current_kv_num) override {
+    double load_factor(map_type *clevel, size_t current_kv_num) {
         return (double) current_kv_num * 8 / clevel->get_memory_usage();
     }
 
-    void do_close(map_type *clevel, config const &cfg) override {
+    void do_close(map_type *clevel, config const &cfg) {
         clevel->~map_type();
     }
 
     void do_ycsb_insert(map_type *map, context *ctx, ycsb::INSERT const &cmd,
-                        size_t pkv, bool is_load = false) override {
+                        size_t pkv, bool is_load = false) {
         auto k = key_type{};
         strncpy(k.begin(), cmd.key(), STRING_LENGTH);
         auto v = mapped_type{};
@@ -78,13 +78,13 @@ struct clevel : public bench_interface<clevel_map_type> {
 #endif
     }
     void do_ycsb_read(map_type *map, context *ctx,
-                      ycsb::READ const &cmd) override {
+                      ycsb::READ const &cmd) {
         auto k = key_type{};
         strncpy(k.begin(), cmd.key(), STRING_LENGTH);
         map->search(k);
     }
     void do_ycsb_update(map_type *map, context *ctx, ycsb::UPDATE const &cmd,
-                        size_t pkv = 0) override {
+                        size_t pkv = 0) {
         auto k = key_type{};
         strncpy(k.begin(), cmd.key(), STRING_LENGTH);
         auto v = mapped_type{};
@@ -100,7 +100,7 @@ struct clevel : public bench_interface<clevel_map_type> {
         // }
     }
     void do_ycsb_delete(map_type *map, context *ctx,
-                        ycsb::DELETE const &cmd) override {
+                        ycsb::DELETE const &cmd) {
         auto k = key_type{};
         strncpy(k.begin(), cmd.key(), STRING_LENGTH);
         map->erase(k, ctx->tid);
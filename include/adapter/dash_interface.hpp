@@ -10,10 +10,14 @@ namespace pmhb_ns::adapter {
 // inline constexpr auto STRING_LENGTH = 32ul;
 
 
-struct dash : public bench_interface<dash_ns::Finger_EH<varlen_kv>> {
+struct dash : public bench_interface<dash_ns::Finger_EH<varlen_kv>, dash> {
     using map_type = dash_ns::Finger_EH<varlen_kv>;
 
-    map_type *do_open(config const &cfg, size_t kv_uulo) override {
+    void do_persistence_domain(bool eadr) {
+        dash_ns::Allocator::eadr_ = eadr;
+    }
+
+    map_type *do_open(config const &cfg, size_t kv_uulo) {
         auto path = cfg.working_dir / "dash";
         std::filesystem::remove_all(path);
         dash_ns::Allocator::Initialize(path.c_str(),
@@ -31,7 +35,7 @@ struct dash : public bench_interface<dash_ns::Finger_EH<varlen_kv>> {
         return map;
     }
 
-    map_type *do_recover(config const &cfg) override {
+    map_type *do_recover(config const &cfg) {
         auto path = cfg.working_dir / "dash";
         dash_ns::Allocator::Initialize(path.c_str(),
                                        pmhb_ns::MAP_STRUCTURE_SIZE);
@@ -47,18 +51,18 @@ struct dash : public bench_interface<dash_ns::Finger_EH<varlen_kv>> {
 
         return map;
     }
-    double load_factor(map_type *map, size_t current_kv_num) override {
+    double load_factor(map_type *map, size_t current_kv_num) {
         return (double) current_kv_num * 16 / map->get_memory_usage();
     }
 
-    void do_close(map_type *map, config const &cfg) override {
+    void do_close(map_type *map, config const &cfg) {
         map->~map_type();
         dash_ns::Allocator::Close_pool();
     }
 
     void do_ycsb_insert(map_type *map, context *ctx,
                         pmhb_ns::ycsb::INSERT const &cmd, size_t pkv,
-                        bool is_load = false) override {
+                        bool is_load = false) {
 #ifndef WRITE_KV
         auto k_ptr = dash_ns::c_ptr<varlen_kv::K_TYPE>(pkv + sizeof(varlen_kv));
         auto v_ptr = dash_ns::c_ptr<varlen_kv::V_TYPE>(
@@ -81,7 +85,7 @@ struct dash : public bench_interface<dash_ns::Finger_EH<varlen_kv>> {
         // }
     }
     void do_ycsb_read(map_type *map, context *ctx,
-                      pmhb_ns::ycsb::READ const &cmd) override {
+                      pmhb_ns::ycsb::READ const &cmd) {
         auto ret = map->Get(cmd.key());
         // if (ret == nullptr) [[unlikely]] {
         //     fmt::print("search failed {}", cmd.key());
@@ -89,7 +93,7 @@ struct dash : public bench_interface<dash_ns::Finger_EH<varlen_kv>> {
         // }
     }
     void do_ycsb_update(map_type *map, context *ctx,
-                        pmhb_ns::ycsb::UPDATE const &cmd, size_t pkv) override {
+                        pmhb_ns::ycsb::UPDATE const &cmd, size_t pkv) {
         // static size_t counter = 0;
 #ifndef WRITE_KV
         auto k_ptr = dash_ns::c_ptr<varlen_kv::K_TYPE>(pkv + sizeof(varlen_kv));
@@ -113,11 +117,11 @@ struct dash : public bench_interface<dash_ns::Finger_EH<varlen_kv>> {
         // }
     }
     void do_ycsb_delete(map_type *map, context *ctx,
-                        pmhb_ns::ycsb::DELETE const &cmd) override {
+                        pmhb_ns::ycsb::DELETE const &cmd) {
         map->Delete(cmd.key());
     }
     void do_ycsb_check(map_type *map, context *ctx,
-                       pmhb_ns::ycsb::CHECK const &cmd) override {
+                       pmhb_ns::ycsb::CHECK const &cmd) {
         auto ret = map->Get(cmd.key());
         // if (ret) {
         //     int diff = strcmp(cmd.value(), ret);
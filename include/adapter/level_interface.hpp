@@ -8,14 +8,18 @@ namespace pmhb_ns::adapter {
 
 using level_map_type = level_ns::LevelHashing<varlen_kv>;
 
-struct level : public bench_interface<level_map_type> {
+struct level : public bench_interface<level_map_type, level> {
     using map_type = level_map_type;
 
     struct root_type {
         pmem::obj::persistent_ptr<map_type> map{};
     };
 
-    map_type *do_open(config const &cfg, size_t kv_uulo) override {
+    void do_persistence_domain(bool eadr) {
+        level_ns::eadr_domain = eadr;
+    }
+
+    map_type *do_open(config const &cfg, size_t kv_uulo) {
         auto path = cfg.working_dir / "level";
         std::filesystem::remove_all(path);
         auto pool = pmem::obj::pool<root_type>::create(
@@ -42,11 +46,11 @@ struct level : public bench_interface<level_map_type> {
 #endif
         return root->map.get();
     }
-    double load_factor(map_type *map, size_t current_kv_num) override {
+    double load_factor(map_type *map, size_t current_kv_num) {
         return (double) current_kv_num * 16 / map->get_memory_usage();
     }
 
-    map_type *do_recover(config const &cfg) override {
+    map_type *do_recover(config const &cfg) {
         auto path = cfg.working_dir / "level";
         auto pool = pmem::obj::pool<root_type>::open(path, "level");
         auto root = pool.root();
@@ -63,12 +67,12 @@ struct level : public bench_interface<level_map_type> {
         return root->map.get();
     }
 
-    void do_close(map_type *level, config const &cfg) override {
+    void do_close(map_type *level, config const &cfg) {
         level->~map_type();
     }
 
     void do_ycsb_insert(map_type *map, context *ctx, ycsb::INSERT const &cmd,
-                        size_t off = 0, bool is_load = false) override {
+                        size_t off = 0, bool is_load = false) {
 #ifdef WRITE_KV
         level_ns::c_ptr<varlen_kv> p_kv(0ul);
 #else
@@ -77,11 +81,11 @@ struct level : public bench_interface<level_map_type> {
         auto ret = map->Insert(cmd.key(), cmd.value(), p_kv);
     }
     void do_ycsb_read(map_type *map, context *ctx,
-                      ycsb::READ const &cmd) override {
+                      ycsb::READ const &cmd) {
         auto ret = map->Get(cmd.key());
     }
     void do_ycsb_update(map_type *map, context *ctx, ycsb::UPDATE const &cmd,
-                        size_t off = 0) override {
+                        size_t off = 0) {
 #ifdef WRITE_KV
         level_ns::c_ptr<varlen_kv> p_kv(0ul);
 #else
@@ -94,7 +98,7 @@ struct level : public bench_interface<level_map_type> {
         // }
     }
     void do_ycsb_delete(map_type *map, context *ctx,
-                        ycsb::DELETE const &cmd) override {
+                        ycsb::DELETE const &cmd) {
         map->Delete(cmd.key());
     }
 };
@@ -9,7 +9,7 @@ namespace pmhb_ns::adapter {
 using clht_map_type = pclht_ns::clht<std::array<char, STRING_LENGTH>,
                                      std::array<char, STRING_LENGTH>>;
 
-struct clht : public bench_interface<clht_map_type> {
+struct clht : public bench_interface<clht_map_type, clht> {
     using map_type = clht_map_type;
     using key_type = map_type::key_type;
     using mapped_type = map_type::mapped_type;
@@ -19,7 +19,7 @@ struct clht : public bench_interface<clht_map_type> {
         pmem::obj::persistent_ptr<map_type> map{};
     };
 
-    map_type *do_open(config const &cfg, size_t kv_uulo) override {
+    map_type *do_open(config const &cfg, size_t kv_uulo) {
         auto path = cfg.working_dir / "clht";
         std::filesystem::remove_all(path);
         auto pool = pmem::obj::pool<root_type>::create(
@@ -40,7 +40,7 @@ struct clht : public bench_interface<clht_map_type> {
         return root->map.get();
     }
 
-    map_type *do_recover(config const &cfg) override {
+    map_type *do_recover(config const &cfg) {
         auto path = cfg.working_dir / "clht";
         auto pool = pmem::obj::pool<root_type>::open(path, "clht");
         auto root = pool.root();
@@ -56,16 +56,16 @@ struct clht : public bench_interface<clht_map_type> {
         return root->map.get();
     }
 
-    double load_factor(map_type *clht, size_t current_kv_num) override {
+    double load_factor(map_type *clht, size_t current_kv_num) {
         return (double) current_kv_num * 8 / clht->get_memory_usage();
     }
 
-    void do_close(map_type *clht, config const &cfg) override {
+    void do_close(map_type *clht, config const &cfg) {
         clht->~map_type();
     }
 
     void do_ycsb_insert(map_type *map, context *ctx, ycsb::INSERT const &cmd,
-                        size_t pkv, bool is_load = false) override {
+                        size_t pkv, bool is_load = false) {
         static bool start = false;
         auto k = key_type{};
         strncpy(k.begin(), cmd.key(), STRING_LENGTH);
@@ -91,13 +91,13 @@ struct clht : public bench_interface<clht_map_type> {
         // }
     }
     void do_ycsb_read(map_type *map, context *ctx,
-                      ycsb::READ const &cmd) override {
+                      ycsb::READ const &cmd) {
         auto k = key_type{};
         strncpy(k.begin(), cmd.key(), STRING_LENGTH);
         map->get(k);
     }
     void do_ycsb_update(map_type *map, context *ctx, ycsb::UPDATE const &cmd,
-                        size_t pkv) override {
+                        size_t pkv) {
         auto k = key_type{};
         strncpy(k.begin(), cmd.key(), STRING_LENGTH);
         auto v = mapped_type{};
@@ -119,7 +119,7 @@ struct clht : public bench_interface<clht_map_type> {
         // }
     }
     void do_ycsb_delete(map_type *map, context *ctx,
-                        ycsb::DELETE const &cmd) override {
+                        ycsb::DELETE const &cmd) {
         auto k = key_type{};
         strncpy(k.begin(), cmd.key(), STRING_LENGTH);
         map->erase(k);
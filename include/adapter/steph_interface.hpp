@@ -11,18 +11,23 @@ namespace pmhb_ns::adapter {
 
 using steph_map_type = steph_ns::steph<varlen_kv>;
 
-struct steph : public bench_interface<steph_map_type> {
+struct steph : public bench_interface<steph_map_type, steph> {
     using map_type = steph_map_type;
 
-    map_type *do_open(config const &cfg, size_t kv_uulo) override {
+    void do_persistence_domain(bool eadr) {
+        steph_ns::persistence_domain::set_eadr(eadr);
+    }
+
+    map_type *do_open(config const &cfg, size_t kv_uulo) {
         auto path = cfg.working_dir / "steph";
         auto depth = 8ul;
         std::filesystem::remove_all(path);
-        auto map = map_type::open(path, MAP_STRUCTURE_SIZE, depth, kv_uulo);
+        auto map = map_type::open(path, MAP_STRUCTURE_SIZE, depth, kv_uulo,
+                                  cfg.expected_keys, cfg.epoch_us);
         return map;
     }
 
-    double load_factor(map_type *map, size_t current_kv_num) override {
+    double load_factor(map_type *map, size_t current_kv_num) {
         auto ret = map->get_memory_usage();
         // fmt::print("{} th with size {}, lf = {}\n", current_kv_num, ret,
         //            (double) current_kv_num * 8 / ret);
@@ -30,9 +35,10 @@ struct steph : public bench_interface<steph_map_type> {
         // return (double) current_kv_num * 8 / map->get_memory_usage();
     }
 
-    map_type *do_recover(config const &cfg) override {
+    map_type *do_recover(config const &cfg) {
         auto path = cfg.working_dir / "steph";
-        auto map = map_type::open(path);
+        auto map = map_type::open(path, DEFAULT_POOL_SIZE, 8, 0, 0,
+                                  cfg.epoch_us);
 
         auto out_path = cfg.output_dir / "recover";
         auto f = fmt::output_file(out_path.c_str());
@@ -43,14 +49,15 @@ struct steph : public bench_interface<steph_map_type> {
         return map;
     }
 
-    void do_close(map_type *map, config const &cfg) override {
+    void do_close(map_type *map, config const &cfg) {
+        fmt::print("steph stats: {}\n", map_type::stats().information());
         map_type::close(map);
     }
 
     void do_ycsb_insert(map_type *map, context *ctx,
                         pmhb_ns::ycsb::INSERT const &cmd, size_t off,
-                        bool is_load = false) override {
-#ifdef WRITE_KV
+                        bool is_load = false) {
+#if defined(WRITE_KV) || defined(VALUE_HEAP)
         map->insert(cmd.key(), std::string_view{cmd.value()}.substr(0, 32),
                     0ul);
 #else
@@ -68,7 +75,7 @@ struct steph : public bench_interface<steph_map_type> {
     }
 
     void do_ycsb_read(map_type *map, context *ctx,
-                      pmhb_ns::ycsb::READ const &cmd) override {
+                      pmhb_ns::ycsb::READ const &cmd) {
         auto ret = map->search(cmd.key());
         // if (ret == nullptr) [[unlikely]] {
         //         fmt::print("search {} returned nullptr", cmd.key());
@@ -77,8 +84,8 @@ struct steph : public bench_interface<steph_map_type> {
 
     void do_ycsb_update(map_type *map, context *ctx,
                         pmhb_ns::ycsb::UPDATE const &cmd,
-                        size_t off = 0) override {
-#ifdef WRITE_KV
+                        size_t off = 0) {
+#if defined(WRITE_KV) || defined(VALUE_HEAP)
         auto ret = map->update(
                 cmd.key(), std::string_view{cmd.value()}.substr(0, 32), 0ul);
 #else
@@ -92,7 +99,7 @@ struct steph : public bench_interface<steph_map_type> {
     }
 
     void do_ycsb_delete(map_type *map, context *ctx,
-                        pmhb_ns::ycsb::DELETE const &cmd) override {
+                        pmhb_ns::ycsb::DELETE const &cmd) {
         auto ret = map->Delete(cmd.key());
         // if (ret == false) {
         //     fmt::print("Delete failed\n");
@@ -100,8 +107,53 @@ struct steph : public bench_interface<steph_map_type> {
         // }
     }
 
+#if !defined(WRITE_KV) && !defined(VALUE_HEAP)
+    /* Build the table with steph::bulk_load from the KVs in the trace */
+    void do_bulk_load(
+            map_type *map, context *ctx,
+            std::vector<std::pair<ycsb::command *, size_t>> const &cmds,
+            size_t thread_num) {
+        std::vector<std::pair<std::string_view, steph_ns::kv_ptr<varlen_kv>>>
+                kvs;
+        kvs.reserve(cmds.size());
+        for (auto const &[pcmd, off] : cmds) {
+            if (auto insert = std::get_if<ycsb::INSERT>(pcmd)) {
+                kvs.push_back({insert->key(),
+                               steph_ns::kv_ptr<varlen_kv>{off, 0, 0, 0}});
+            } else {
+                do_ycsb_command(map, ctx, *pcmd, off, true);
+            }
+        }
+        if (!map->bulk_load(kvs, thread_num)) {
+            bench_interface::do_bulk_load(map, ctx, cmds, thread_num);
+        }
+    }
+#endif
+
+    /* Interleave the lookups of a batch with steph_ns::coro, other commands
+     * run inline */
+    void do_ycsb_commands(
+            map_type *map, context *ctx,
+            std::vector<std::pair<ycsb::command *, size_t>> const &cmds,
+            size_t coroutine_num) {
+        auto s = steph_ns::coro::scheduler{coroutine_num};
+        for (auto const &[pcmd, off] : cmds) {
+            if (auto read = std::get_if<ycsb::READ>(pcmd)) {
+                s.spawn(async_read(map, read->key()));
+            } else {
+                do_ycsb_command(map, ctx, *pcmd, off);
+            }
+        }
+        s.drain();
+    }
+
+    static steph_ns::coro::task<> async_read(map_type *map,
+                                             std::string_view k) {
+        auto ret = co_await map->search_async(k);
+    }
+
     void do_ycsb_check(map_type *map, context *ctx,
-                       pmhb_ns::ycsb::CHECK const &cmd) override {
+                       pmhb_ns::ycsb::CHECK const &cmd) {
         auto ret = map->search(cmd.key());
         // if (ret) {
         //     int diff = strcmp(cmd.value(), ret->value());
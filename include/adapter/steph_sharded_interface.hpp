@@ -0,0 +1,109 @@
+#ifndef PMHB_ADAPTER_STEPH_SHARDED_HPP
+#define PMHB_ADAPTER_STEPH_SHARDED_HPP
+
+#include "bench.hpp"
+#include "bench_interface.hpp"
+#include "sharded.hpp"
+
+#include <vector>
+
+
+namespace pmhb_ns::adapter {
+
+
+/* steph sharded over the shard directories, one table per PM namespace */
+struct steph_sharded
+    : public bench_interface<steph_ns::sharded_steph<varlen_kv>,
+                             steph_sharded> {
+    using map_type = steph_ns::sharded_steph<varlen_kv>;
+
+    static std::vector<std::filesystem::path> pool_paths(config const &cfg) {
+        auto dirs = cfg.shard_dirs;
+        if (dirs.empty()) { dirs.push_back(cfg.working_dir); }
+        std::vector<std::filesystem::path> ret;
+        for (auto const &dir : dirs) { ret.push_back(dir / "steph"); }
+        return ret;
+    }
+
+    void do_persistence_domain(bool eadr) {
+        steph_ns::persistence_domain::set_eadr(eadr);
+    }
+
+    map_type *do_open(config const &cfg, size_t kv_uulo) {
+        auto paths = pool_paths(cfg);
+        for (auto const &path : paths) {
+            std::filesystem::remove_all(path);
+            auto seg_path = path;
+            seg_path += ".seg";
+            std::filesystem::remove_all(seg_path);
+        }
+        return map_type::open(paths, MAP_STRUCTURE_SIZE, 8, kv_uulo,
+                              cfg.expected_keys, cfg.epoch_us);
+    }
+
+    double load_factor(map_type *map, size_t current_kv_num) {
+        return (double) current_kv_num * 8 / map->get_memory_usage();
+    }
+
+    map_type *do_recover(config const &cfg) {
+        auto map = map_type::open(pool_paths(cfg), DEFAULT_POOL_SIZE, 8, 0, 0,
+                                  cfg.epoch_us);
+
+        auto out_path = cfg.output_dir / "recover";
+        auto f = fmt::output_file(out_path.c_str());
+        f.print("{}\n", clock::now().time_since_epoch().count());
+        f.close();
+        map->recover();
+
+        return map;
+    }
+
+    void do_close(map_type *map, config const &cfg) {
+        fmt::print("steph stats: {}\n", map_type::stats().information());
+        map_type::close(map);
+    }
+
+    void do_ycsb_insert(map_type *map, context *ctx,
+                        pmhb_ns::ycsb::INSERT const &cmd, size_t off,
+                        bool is_load = false) {
+#if defined(WRITE_KV) || defined(VALUE_HEAP)
+        map->insert(cmd.key(), std::string_view{cmd.value()}.substr(0, 32),
+                    0ul);
+#else
+        map->insert(cmd.key(), std::string_view{cmd.value()}.substr(0, 32), off,
+                    is_load);
+#endif
+    }
+
+    void do_ycsb_read(map_type *map, context *ctx,
+                      pmhb_ns::ycsb::READ const &cmd) {
+        auto ret = map->search(cmd.key());
+    }
+
+    void do_ycsb_update(map_type *map, context *ctx,
+                        pmhb_ns::ycsb::UPDATE const &cmd,
+                        size_t off = 0) {
+#if defined(WRITE_KV) || defined(VALUE_HEAP)
+        auto ret = map->update(
+                cmd.key(), std::string_view{cmd.value()}.substr(0, 32), 0ul);
+#else
+        auto ret = map->update(
+                cmd.key(), std::string_view{cmd.value()}.substr(0, 32), off);
+#endif
+    }
+
+    void do_ycsb_delete(map_type *map, context *ctx,
+                        pmhb_ns::ycsb::DELETE const &cmd) {
+        auto ret = map->Delete(cmd.key());
+    }
+
+    void do_ycsb_check(map_type *map, context *ctx,
+                       pmhb_ns::ycsb::CHECK const &cmd) {
+        auto ret = map->search(cmd.key());
+    }
+};
+
+
+}// namespace pmhb_ns::adapter
+
+#endif
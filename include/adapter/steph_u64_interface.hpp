@@ -0,0 +1,102 @@
+#ifndef PMHB_ADAPTER_STEPH_U64_HPP
+#define PMHB_ADAPTER_STEPH_U64_HPP
+
+#include "bench.hpp"
+#include "bench_interface.hpp"
+#include "steph_u64.hpp"
+
+#include <charconv>
+#include <cstring>
+
+
+namespace pmhb_ns::adapter {
+
+
+struct steph_u64 : public bench_interface<steph_ns::steph_u64, steph_u64> {
+    using map_type = steph_ns::steph_u64;
+
+    void do_persistence_domain(bool eadr) {
+        steph_ns::persistence_domain::set_eadr(eadr);
+    }
+
+    map_type *do_open(config const &cfg, size_t kv_uulo) {
+        auto path = cfg.working_dir / "steph_u64";
+        std::filesystem::remove_all(path);
+        return map_type::open(path, MAP_STRUCTURE_SIZE, 8);
+    }
+
+    double load_factor(map_type *map, size_t current_kv_num) {
+        return (double) current_kv_num * sizeof(steph_ns::u64_pair) /
+               map->get_memory_usage();
+    }
+
+    map_type *do_recover(config const &cfg) {
+        auto path = cfg.working_dir / "steph_u64";
+        auto map = map_type::open(path);
+
+        auto out_path = cfg.output_dir / "recover";
+        auto f = fmt::output_file(out_path.c_str());
+        f.print("{}\n", clock::now().time_since_epoch().count());
+        f.close();
+        map->recover();
+
+        return map;
+    }
+
+    void do_close(map_type *map, config const &cfg) {
+        fmt::print("steph_u64 stats: {}\n", map_type::stats().information());
+        map_type::close(map);
+    }
+
+    void do_ycsb_insert(map_type *map, context *ctx,
+                        pmhb_ns::ycsb::INSERT const &cmd, size_t off,
+                        bool is_load = false) {
+        map->insert(key_of(cmd.key()), value_of(cmd.value()));
+    }
+
+    void do_ycsb_read(map_type *map, context *ctx,
+                      pmhb_ns::ycsb::READ const &cmd) {
+        auto ret = map->search(key_of(cmd.key()));
+    }
+
+    void do_ycsb_update(map_type *map, context *ctx,
+                        pmhb_ns::ycsb::UPDATE const &cmd,
+                        size_t off = 0) {
+        auto ret = map->update(key_of(cmd.key()), value_of(cmd.value()));
+    }
+
+    void do_ycsb_delete(map_type *map, context *ctx,
+                        pmhb_ns::ycsb::DELETE const &cmd) {
+        auto ret = map->Delete(key_of(cmd.key()));
+    }
+
+    void do_ycsb_check(map_type *map, context *ctx,
+                       pmhb_ns::ycsb::CHECK const &cmd) {
+        auto ret = map->search(key_of(cmd.key()));
+    }
+
+    /* The YCSB keys are decimal numbers after an optional prefix like
+     * "user", other keys are hashed */
+    static uint64_t key_of(std::string_view k) {
+        uint64_t ret = 0;
+        auto pos = k.find_first_of("0123456789");
+        if (pos == std::string_view::npos ||
+            std::from_chars(k.data() + pos, k.data() + k.size(), ret).ec !=
+                    std::errc{}) {
+            return std::hash<std::string_view>{}(k);
+        }
+        return ret;
+    }
+
+    /* The first 8 bytes of the value */
+    static uint64_t value_of(std::string_view v) {
+        uint64_t ret = 0;
+        memcpy(&ret, v.data(), std::min(v.size(), sizeof(ret)));
+        return ret;
+    }
+};
+
+
+}// namespace pmhb_ns::adapter
+
+#endif//PMHB_ADAPTER_STEPH_U64_HPP
@@ -0,0 +1,43 @@
+#ifndef PMHB_ARRIVAL_HPP
+#define PMHB_ARRIVAL_HPP
+
+#include "utils.hpp"
+
+#include <cmath>
+#include <immintrin.h>
+#include <random>
+
+namespace pmhb_ns {
+
+/* The intended start times of the commands of a worker in the open-loop
+ * mode: rate commands per second, evenly spaced or as a Poisson process.
+ * The times do not move when the table stalls, so the commands queued
+ * behind a stall are charged for it. */
+struct arrival_schedule {
+    /* Data members */
+    time_point origin;
+    double offset_ns = 0;
+    double interval_ns;
+    bool poisson;
+    std::mt19937_64 rng;
+    std::exponential_distribution<double> gap;
+
+    /* Constructors */
+    arrival_schedule(double rate, bool in_poisson, size_t seed)
+        : origin(clock::now()), interval_ns(1e9 / rate), poisson(in_poisson),
+          rng(seed), gap(1.0 / interval_ns) {}
+
+    /* Interfaces */
+    /* Wait for the start time of the next command and return it. If the
+     * worker is behind, it returns at once */
+    time_point wait_next() {
+        auto intended = origin + duration{std::llround(offset_ns)};
+        offset_ns += poisson ? gap(rng) : interval_ns;
+        while (clock::now() < intended) { _mm_pause(); }
+        return intended;
+    }
+};
+
+}// namespace pmhb_ns
+
+#endif//PMHB_ARRIVAL_HPP
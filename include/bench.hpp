@@ -1,9 +1,13 @@
 #ifndef PMHB_BENCH_HPP
 #define PMHB_BENCH_HPP
 
+#include "arrival.hpp"
 #include "bench_interface.hpp"
 #include "config.hpp"
 #include "context.hpp"
+#include "distribution.hpp"
+#include "flush_trace.hpp"
+#include "perf_counter.hpp"
 #include "performance_profile.hpp"
 #include "utils.hpp"
 #include "ycsb.hpp"
@@ -32,25 +36,28 @@ namespace pmhb_ns {
 
 // this should be a singleton
 // root of the one whole benchmark session
-template<typename map_type>
+// instantiated per adapter, so that the commands are dispatched statically
+template<bench_adapter adapter_type>
 struct bench {
+    /* Types */
+    using map_type = typename adapter_type::map_type;
+
     /* Data */
     inline static bench *g_bench;
     std::unique_ptr<config> cfg;
-    std::shared_ptr<bench_interface<map_type>> interface;
+    std::shared_ptr<adapter_type> interface;
     std::unique_ptr<performance_profile> profiler;
     std::unique_ptr<std::barrier<std::__empty_completion>> sync_point;
     std::unique_ptr<ycsb> ycsb_data;
     map_type *table{nullptr};
 
-    std::atomic<size_t> test_pointer = 0;
+    work_partition::counter test_pointer;
 
     /* Constructors */
     bench() = delete;
     bench(bench const &) = delete;
     bench &operator=(bench const &) = delete;
-    explicit bench(config const &c,
-                   std::shared_ptr<bench_interface<map_type>> _interface)
+    explicit bench(config const &c, std::shared_ptr<adapter_type> _interface)
         : cfg{std::make_unique<config>(c)}, interface(_interface),
           profiler{std::make_unique<performance_profile>()},
           ycsb_data{std::make_unique<ycsb>(*cfg)},
@@ -67,8 +74,10 @@ struct bench {
         // std::filesystem::create_directory(cfg->output_dir);
         std::filesystem::create_directory(cfg->working_dir);
 
+        profiler->live.print = cfg->live_report;
         fmt::print("creating bench instance with config {}\n", *cfg);
         g_bench = this;
+        bench_profiler<map_type> = profiler.get();
     }
 
     /* Interfaces */
@@ -80,7 +89,6 @@ struct bench {
 
 private:
     /* Private data */
-    std::mutex ctx_init_lock;
     std::atomic<bool> ok_to_start{false};
     std::atomic<size_t> ready_thread_num{0};
 
@@ -105,65 +113,100 @@ private:
         const size_t batch_size =
                 (cfg->load_num + cfg->run_num > 100000) ? 1000 : 1;
         bool is_main_worker = worker_id == cfg->thread_num - 1;
-#ifdef REALTIMETHROUGHPUT
-        std::vector<time_point> work_done_point;
-        work_done_point.reserve(1'000'000);
-#endif
         /* Prepare the environment */
-        std::shared_ptr<context> ctx;
-        {
-            auto g = std::lock_guard{ctx_init_lock};
-            auto [pos, succ] = profiler->ctxs.insert(
-                    {std::this_thread::get_id(),
-                     std::make_shared<context>(4 * cfg->run_num /
-                                               cfg->thread_num)});
-            ctx = pos->second;
-            ctx->tid = worker_id + reserved_thread_num;
-        }
+        auto ctx = profiler->register_thread(4 * cfg->run_num /
+                                             cfg->thread_num);
+        ctx->tid = worker_id + reserved_thread_num;
         cpubind(LOGIC_PUS[ctx->tid]);
         // fmt::print("worker {} thread {} running on cpu {}\n", worker_id,
         //            pthread_self(), sched_getcpu());
-        test_pointer.store(0);
+        test_pointer.next.store(0);
+        auto load_work = partition(worker_id, cfg->load_num, batch_size);
+        auto run_work = partition(worker_id, cfg->run_num, batch_size);
+        /* The workers generate the trace and copy it out of the pool in
+         * their static partitions, which numa reads on their nodes */
+        auto load_part = work_partition{nullptr, cfg->load_num, worker_id,
+                                        cfg->thread_num, batch_size};
+        auto run_part = work_partition{nullptr, cfg->run_num, worker_id,
+                                       cfg->thread_num, batch_size};
+        if (!cfg->workload.empty()) {
+            ycsb_data->generate_commands(false, load_part.begin, load_part.end,
+                                         worker_id);
+            ycsb_data->generate_commands(true, run_part.begin, run_part.end,
+                                         worker_id);
+        }
+        if (cfg->trace_mode != "pm") {
+            ycsb_data->stream_commands(false, load_part.begin, load_part.end);
+            ycsb_data->stream_commands(true, run_part.begin, run_part.end);
+        } else if (cfg->distribution == "numa") {
+            /* The partitions of the worker are read on its node */
+            auto node = current_node();
+            ycsb_data->place_commands(false, load_work.begin, load_work.end,
+                                      node);
+            ycsb_data->place_commands(true, run_work.begin, run_work.end,
+                                      node);
+        }
+        auto counters = perf_counters{};
+        if (cfg->perf_counters) { counters.open(); }
 
 
-        if (is_main_worker) { fmt::print("Load Phase\n"); }
+        if (is_main_worker) {
+            /* The flushes of opening the table are not in the load phase */
+            flush_tracer::collect();
+            fmt::print("Load Phase\n");
+        }
         sync_point.get()->arrive_and_wait();
 
         /* LOAD PHASE */
-        {
+        counters.start();
+        if (cfg->bulk_load) {
+            /* The main worker hands the whole load over to the table, which
+             * may use all the workers' cores */
+            if (is_main_worker) {
+                auto p = perf_guard(fmt::format(
+                        "load_worker_id {} time_slice (bulk)", worker_id));
+                std::vector<std::pair<ycsb::command *, size_t>> cmds;
+                cmds.reserve(cfg->load_num);
+                for (size_t i = 0; i < cfg->load_num; i++) {
+                    cmds.push_back(ycsb_data->get_load_command(i));
+                }
+                interface->do_bulk_load(table, ctx, cmds, cfg->thread_num);
+            }
+        } else {
             auto p = perf_guard(
                     fmt::format("load_worker_id {} time_slice", worker_id));
-            size_t terminator = cfg->load_num;
+            size_t terminator = load_work.end;
             while (true) {
-                size_t i = test_pointer.fetch_add(batch_size,
-                                                  std::memory_order_relaxed);
+                size_t i = load_work.take();
                 // fmt::print("{} th got the {}th batch\n", ctx->tid, i);
                 if (i >= terminator) { break; }
+                size_t first = i;
                 for (int j = 0; j < batch_size; j++, i++) {
                     if (i >= terminator) { break; }
                     auto [pcmd, offset] = ycsb_data->get_load_command(i);
-                    interface->do_ycsb_command(table, ctx.get(), *pcmd, offset,
-                                               true);
+                    interface->do_ycsb_command(table, ctx, *pcmd, offset, true);
                 }
+                ctx->live->add_ops(clock::now(), i - first);
             }
         }
+        if (cfg->perf_counters) { profiler->add_perf("load", counters.stop()); }
 
         sync_point.get()->arrive_and_wait();
 
         pm_watch *w;
         /* wait or issue the start signal for the second phase: run */
         if (is_main_worker) {
-            for (auto &[_, ctx] : profiler->ctxs) {
-                ctx->samples.clear();
-                ctx->write_count = 0;
-            }
+            for (auto &[_, ctx] : profiler->ctxs) { ctx->reset(); }
+            profiler->flushes["load"] = flush_tracer::collect();
             fmt::print("Run Phase\n");
+            profiler->live.mark_run();
             w = new pm_watch();
-            test_pointer.store(0);
+            test_pointer.next.store(0);
         }
 
 
         sync_point.get()->arrive_and_wait();
+        counters.start();
 
 #ifdef CORRECTNESS_CHECK
         /* CHECK PHASE */
@@ -174,21 +217,20 @@ private:
             auto p = perf_guard(
                     fmt::format("run_worker_id {} time_slice", worker_id));
             ycsb::CHECK p_cmd;
-            size_t terminator = cfg->load_num;
+            auto check_work = partition(worker_id, cfg->load_num, batch_size);
+            size_t terminator = check_work.end;
             while (true) {
-                size_t i = test_pointer.fetch_add(batch_size,
-                                                  std::memory_order_relaxed);
+                size_t i = check_work.take();
                 if (i >= terminator) { break; }
+                size_t first = i;
                 for (int j = 0; j < batch_size; j++) {
                     auto [pcmd, offset] = ycsb_data->get_load_command(i);
                     new (&p_cmd) ycsb::CHECK(std::get<ycsb::INSERT>(*pcmd));
                     // ycsb::CHECK here
-                    interface->do_ycsb_command(table, ctx.get(), p_cmd);
+                    interface->do_ycsb_command(table, ctx, p_cmd);
                     if (++i >= terminator) { break; }
                 }
-#ifdef REALTIMETHROUGHPUT
-                work_done_point.push_back(time_point{clock::now()});
-#endif
+                ctx->live->add_ops(clock::now(), i - first);
             }
             // }
             // fmt::print("passed the check\n");
@@ -198,15 +240,22 @@ private:
         {
             auto p = perf_guard(
                     fmt::format("run_worker_id {} time_slice", worker_id));
-            size_t terminator = cfg->run_num;
+            size_t terminator = run_work.end;
             double percent = 0.05;
+            std::vector<std::pair<ycsb::command *, size_t>> batch;
+            batch.reserve(batch_size);
+            /* Open loop: the workers share target_rate */
+            auto arrivals = arrival_schedule{
+                    cfg->target_rate ? cfg->target_rate / cfg->thread_num : 1,
+                    cfg->arrival == "poisson", worker_id};
+            ctx->open_loop = cfg->target_rate > 0;
             while (true) {
-                size_t i = test_pointer.fetch_add(batch_size,
-                                                  std::memory_order_relaxed);
+                size_t i = run_work.take();
                 if (i >= terminator) { break; }
+                size_t first = i;
 #ifdef LOAD_FACTOR
                 // sync point
-                if (i >= percent * cfg->run_num) {
+                if (i - run_work.begin >= percent * run_work.size()) {
                     sync_point.get()->arrive_and_wait();
                     if (is_main_worker) {
                         profiler->load_factors.push_back(interface->load_factor(
@@ -218,28 +267,53 @@ private:
                     sync_point.get()->arrive_and_wait();
                 }
 #endif
-                for (int j = 0; j < batch_size; j++) {
-                    auto [pcmd, offset] = ycsb_data->get_run_command(i);
-
-                    interface->do_ycsb_command(table, ctx.get(), *pcmd, offset);
-                    if (++i >= terminator) { break; }
+                if (cfg->target_rate) {
+                    for (int j = 0; j < batch_size; j++) {
+                        auto [pcmd, offset] = ycsb_data->get_run_command(i);
+                        auto intended = arrivals.wait_next();
+                        interface->do_ycsb_command(table, ctx, *pcmd, offset);
+                        ctx->respond(intended, clock::now());
+                        if (++i >= terminator) { break; }
+                    }
+                } else if (cfg->coroutine_num) {
+                    batch.clear();
+                    for (int j = 0; j < batch_size; j++) {
+                        batch.push_back(ycsb_data->get_run_command(i));
+                        if (++i >= terminator) { break; }
+                    }
+                    interface->do_ycsb_commands(table, ctx, batch,
+                                                cfg->coroutine_num);
+                } else {
+                    for (int j = 0; j < batch_size; j++) {
+                        auto [pcmd, offset] = ycsb_data->get_run_command(i);
+
+                        interface->do_ycsb_command(table, ctx, *pcmd, offset);
+                        if (++i >= terminator) { break; }
+                    }
                 }
-#ifdef REALTIMETHROUGHPUT
-                work_done_point.push_back(time_point{clock::now()});
-#endif
+                ctx->live->add_ops(clock::now(), i - first);
             }
         }
 #endif
+        if (cfg->perf_counters) { profiler->add_perf("run", counters.stop()); }
         // fmt::print("Done\n");
         sync_point.get()->arrive_and_wait();
-#ifdef REALTIMETHROUGHPUT
-        profiler->realtime_point[worker_id] = work_done_point;
-#endif
-        if (is_main_worker) { delete w; }
+        if (is_main_worker) {
+            delete w;
+            profiler->flushes["run"] = flush_tracer::collect();
+        }
     }
 
-    void open_table() {
+    /* The commands of a phase the worker takes */
+    work_partition partition(size_t worker_id, size_t total,
+                             size_t batch_size) {
+        return work_partition{
+                cfg->distribution == "shared" ? &test_pointer : nullptr, total,
+                worker_id, cfg->thread_num, batch_size};
+    }
 
+    void open_table() {
+        interface->do_persistence_domain(cfg->eadr);
         if (!cfg->is_recovery) {
             for (const auto &entry :
                  std::filesystem::directory_iterator(cfg->working_dir))
@@ -257,12 +331,14 @@ private:
         std::vector<std::thread> handles{};
         auto worker =
                 std::bind(&bench::worker_body, this, std::placeholders::_1, 0);
+        profiler->live.start();
         for (auto i = 0ul; i < cfg->thread_num - 1; ++i) {
             handles.emplace_back(worker, i);
         }
         /* The main thread that controls the testing */
         worker(cfg->thread_num - 1);
         for (auto &i : handles) { i.join(); }
+        profiler->live.finish();
 
         interface->do_close(table, *cfg);
         time_log("Test over");
@@ -286,8 +362,10 @@ private:
             // auto stream_rttp =
             //         fmt::output_file((cfg->output_dir / "rttp").c_str());
             // stream_rttp.print("{}\n", rttp);
-            fmt::print("\n");
-            fmt::print("RTTP = {}\n", rttp.at(0));
+            if (op.size()) {
+                fmt::print("\n");
+                fmt::print("RTTP = {}\n", rttp.at(0));
+            }
             fmt::print("\n");
             fmt::print("RESIZEKV = {}\n", rttp.at(1));
             fmt::print("\n");
@@ -300,13 +378,39 @@ private:
         }
 
         /* Processing tail latency */
-        vector<size_t> tail_latency = gen_tail_latency(op);
-        if (tail_latency.size()) {
-            // auto stream_tail_latency = fmt::output_file(
-            //         (cfg->output_dir / "tail_latency").c_str());
-            // stream_tail_latency.print("{}\n", tail_latency);
+        auto histograms = merge_histograms(profiler->ctxs);
+        auto all_ops = latency_histogram{};
+        for (auto [name, idx] :
+             {std::pair{"Insert", operation{INSERT{}}.index()},
+              std::pair{"Search", operation{SEARCH{}}.index()},
+              std::pair{"Update", operation{UPDATE{}}.index()},
+              std::pair{"Delete", operation{DELETE{}}.index()}}) {
+            auto const &h = histograms[idx];
+            if (h.count == 0) { continue; }
+            all_ops.merge(h);
+            fmt::print("{}TailLatency = {}\n", name, h.tail());
+            fmt::print("{}AverageLatency_inNanoSecond = {}\n", name, h.mean());
+        }
+        if (all_ops.count) {
             fmt::print("\n");
-            fmt::print("TailLatency = {}\n", tail_latency);
+            fmt::print("TailLatency = {}\n", all_ops.tail());
+        }
+        /* From the intended start times in the open-loop mode */
+        auto response = latency_histogram{};
+        for (auto &[_, ctx] : profiler->ctxs) { response.merge(ctx->response); }
+        if (response.count) {
+            fmt::print("ResponseTailLatency = {}\n", response.tail());
+            fmt::print("ResponseAverageLatency_inNanoSecond = {}\n",
+                       response.mean());
+        }
+        if (raw_samples) {
+            vector<size_t> tail_latency = gen_tail_latency(op);
+            if (tail_latency.size()) {
+                // auto stream_tail_latency = fmt::output_file(
+                //         (cfg->output_dir / "tail_latency").c_str());
+                // stream_tail_latency.print("{}\n", tail_latency);
+                fmt::print("ExactTailLatency = {}\n", tail_latency);
+            }
         }
 
         /* Processing tail latency */
@@ -360,14 +464,24 @@ private:
 
         print_write_count(profiler->ctxs);
 
-#ifdef REALTIMETHROUGHPUT
-        vector<size_t> realtime_throughput =
-                gen_realtime_throughput_only(profiler->realtime_point);
+        /* Processing hardware counters */
+        for (auto const &[phase, sample] : profiler->perf) {
+            fmt::print("PerfCounters_{}_perOp = {}\n", phase,
+                       sample.per_op(phase == "load" ? cfg->load_num
+                                                     : cfg->run_num));
+        }
+
+        /* Processing traced flushes */
+        for (auto const &[phase, report] : profiler->flushes) {
+            if (report.empty()) { continue; }
+            fmt::print("FlushTrace_{} = {}\n", phase, report.information());
+        }
+
+        vector<size_t> realtime_throughput = profiler->live.run_throughput();
         if (realtime_throughput.size()) {
             fmt::print("\n");
             fmt::print("RTTP_only = {}\n", realtime_throughput);
         }
-#endif
 
         time_log("Output over");
 
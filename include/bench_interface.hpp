@@ -4,78 +4,113 @@
 #include "config.hpp"
 #include "context.hpp"
 #include "ycsb.hpp"
+
+#include <concepts>
+#include <utility>
+#include <vector>
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 namespace pmhb_ns {
-// cannot make it static here, because sample_guard needs a single entry point
-// template<typename interface_type, typename map_type>
-// concept bench_interface = requires(map_type *map, config const &cfg,
-//                                    context *ctx, ycsb::command const &cmd) {
-//     { interface_type::do_open(cfg) }
-//     ->std::same_as<map_type *>;
-//     {interface_type::do_ycsb_command(map, cmd, ctx)};
-//     {interface_type::do_close(map, cfg)};
-// };
+/* What bench needs of an adapter, an adapter derives from bench_interface,
+ * which provides the defaults */
+template<typename adapter_type>
+concept bench_adapter =
+        requires(adapter_type &a, typename adapter_type::map_type *map,
+                 config const &cfg, context *ctx, ycsb::command const &cmd) {
+            { a.do_open(cfg, 0ul) } -> std::same_as<decltype(map)>;
+            { a.do_recover(cfg) } -> std::same_as<decltype(map)>;
+            a.do_ycsb_command(map, ctx, cmd, 0ul, false);
+            a.do_close(map, cfg);
+        };
 
-template<typename map_type>
+/* The base of the adapters. The calls are resolved at compile time on the
+ * adapter, the CRTP parameter, so that a command inlines into the table
+ * rather than going through virtual calls for every operation. An adapter
+ * hides the functions it provides. */
+template<typename map_type, typename adapter_type>
 struct bench_interface {
-    virtual map_type *do_open(config const &, size_t kv_uulo = 0) {
+    /* Drop the cache flushes if the caches are persistent (eADR), called
+     * before the table is opened */
+    void do_persistence_domain(bool eadr) {
+        if (eadr) { fmt::print("the scheme keeps its cache flushes\n"); }
+    }
+    map_type *do_open(config const &, size_t kv_uulo = 0) {
         fmt::print("no interface provided!");
         return nullptr;
     }
-    virtual map_type *do_recover(config const &cfg) {
+    map_type *do_recover(config const &cfg) {
         fmt::print("no interface provided!");
         return nullptr;
     }
-    virtual void do_close(map_type *, config const &) {
+    void do_close(map_type *, config const &) {
         fmt::print("no interface provided!");
     }
-    virtual void do_ycsb_insert(map_type *, context *, ycsb::INSERT const &,
-                                size_t off = 0, bool is_load = false) {
+    void do_ycsb_insert(map_type *, context *, ycsb::INSERT const &,
+                        size_t off = 0, bool is_load = false) {
         fmt::print("no interface provided!");
     }
-    virtual void do_ycsb_read(map_type *, context *, ycsb::READ const &) {
+    void do_ycsb_read(map_type *, context *, ycsb::READ const &) {
         fmt::print("no interface provided!");
     }
-    virtual void do_ycsb_update(map_type *, context *, ycsb::UPDATE const &,
-                                size_t off = 0) {
+    void do_ycsb_update(map_type *, context *, ycsb::UPDATE const &,
+                        size_t off = 0) {
         fmt::print("no interface provided!");
     }
-    virtual void do_ycsb_delete(map_type *, context *, ycsb::DELETE const &) {
+    void do_ycsb_delete(map_type *, context *, ycsb::DELETE const &) {
         fmt::print("no interface provided!");
     }
-    virtual void do_ycsb_check(map_type *, context *, ycsb::CHECK const &) {
+    void do_ycsb_check(map_type *, context *, ycsb::CHECK const &) {
         fmt::print("no (check) interface provided!\n");
     }
-    virtual void do_ycsb_command(map_type *map, context *ctx,
-                                 ycsb::command const &cmd, size_t off = 0,
-                                 bool is_load = false) {
+    void do_ycsb_command(map_type *map, context *ctx, ycsb::command const &cmd,
+                         size_t off = 0, bool is_load = false) {
         std::visit(overload{
                            [&](ycsb::INSERT const &cmd) {
-                               do_ycsb_insert(map, ctx, cmd, off, is_load);
+                               self().do_ycsb_insert(map, ctx, cmd, off,
+                                                     is_load);
                            },
                            [&](ycsb::READ const &cmd) {
-                               do_ycsb_read(map, ctx, cmd);
+                               self().do_ycsb_read(map, ctx, cmd);
                            },
                            [&](ycsb::UPDATE const &cmd) {
-                               do_ycsb_update(map, ctx, cmd, off);
+                               self().do_ycsb_update(map, ctx, cmd, off);
                            },
                            [&](ycsb::DELETE const &cmd) {
-                               do_ycsb_delete(map, ctx, cmd);
+                               self().do_ycsb_delete(map, ctx, cmd);
                            },
                            [&](ycsb::CHECK const &cmd) {
-                               do_ycsb_check(map, ctx, cmd);
+                               self().do_ycsb_check(map, ctx, cmd);
                            },
                            [&](ycsb::NONE const &) {},
                    },
                    cmd);
     }
-    virtual double load_factor(map_type *map, size_t current_kv_num) {
+    /* Run a batch of commands with coroutine_num lookups in flight, or one by
+     * one by default */
+    void do_ycsb_commands(
+            map_type *map, context *ctx,
+            std::vector<std::pair<ycsb::command *, size_t>> const &cmds,
+            size_t coroutine_num) {
+        for (auto const &[pcmd, off] : cmds) {
+            self().do_ycsb_command(map, ctx, *pcmd, off);
+        }
+    }
+    /* Load a batch of commands into an empty table at once, or one by one
+     * by default */
+    void do_bulk_load(
+            map_type *map, context *ctx,
+            std::vector<std::pair<ycsb::command *, size_t>> const &cmds,
+            size_t thread_num) {
+        for (auto const &[pcmd, off] : cmds) {
+            self().do_ycsb_command(map, ctx, *pcmd, off, true);
+        }
+    }
+    double load_factor(map_type *map, size_t current_kv_num) {
         fmt::print("no interface provided!");
         return 0.0;
     }
 
-
-    virtual ~bench_interface() = default;
+    /* Helper functions */
+    adapter_type &self() { return static_cast<adapter_type &>(*this); }
 };
 
 }// namespace pmhb_ns
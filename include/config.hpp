@@ -3,6 +3,8 @@
 
 #include "utils.hpp"
 
+#include <vector>
+
 namespace pmhb_ns {
 /* Using CPU2 */
 // inline constexpr auto LOGIC_PUS =
@@ -34,8 +36,34 @@ struct config {
     std::filesystem::path pm_ycsb;
     size_t load_num;
     size_t run_num;
+    size_t coroutine_num{0};
+    size_t expected_keys{0};
+    bool bulk_load{false};
+    bool eadr{false};
+    size_t epoch_us{0};
+    /* The directories of the shards of steph_sharded, one per namespace */
+    std::vector<std::filesystem::path> shard_dirs{};
+    bool live_report{false};
+    /* The open-loop arrival rate of the run phase in operations per
+     * second, 0 for a closed loop, and constant or poisson arrivals */
+    double target_rate{0};
+    std::string arrival{"constant"};
+    /* Count hardware events per worker and phase with perf_event_open */
+    bool perf_counters{false};
+    /* How the workers share the commands, shared, static or numa */
+    std::string distribution{"shared"};
+    /* Where the workers read the trace, pm, dram or hugepage */
+    std::string trace_mode{"pm"};
+    /* The YCSB property file to generate the trace from instead of pm_ycsb,
+     * and the seed of the generators */
+    std::filesystem::path workload{};
+    size_t seed{0};
 
     friend std::ostream &operator<<(std::ostream &os, config const &cfg) {
+        auto shard_dirs = std::string{};
+        for (auto const &dir : cfg.shard_dirs) {
+            shard_dirs += (shard_dirs.empty() ? "" : ",") + dir.string();
+        }
         return os << "{"
                   << fmt::format(
                              "\n\t\"thread_num\": {},\n\t\"is_recovery\": "
@@ -44,12 +72,27 @@ struct config {
                              "\"{}\",\n\t\"ycsb_load_trace\": "
                              "\"{}\",\n\t\"ycsb_run_trace\": "
                              "\"{}\",\n\t\"pm_ycsb\": \"{}\",\n\t\"load_num\": "
-                             "{},\n\t\"run_num\": {}\n",
+                             "{},\n\t\"run_num\": {},\n\t\"coroutine_num\": "
+                             "{},\n\t\"expected_keys\": {},\n\t\"bulk_load\": "
+                             "\"{}\",\n\t\"persistence_domain\": \"{}\",\n\t"
+                             "\"epoch_us\": {},\n\t\"shard_dirs\": \"{}\",\n\t"
+                             "\"live_report\": \"{}\",\n\t"
+                             "\"target_rate\": {},\n\t\"arrival\": \"{}\",\n\t"
+                             "\"perf_counters\": \"{}\",\n\t"
+                             "\"distribution\": \"{}\",\n\t"
+                             "\"trace_mode\": \"{}\",\n\t"
+                             "\"workload\": \"{}\",\n\t\"seed\": {}\n",
                              cfg.thread_num, cfg.is_recovery,
                              cfg.working_dir.c_str(), cfg.output_dir.c_str(),
                              cfg.ycsb_load_trace.c_str(),
                              cfg.ycsb_run_trace.c_str(), cfg.pm_ycsb.c_str(),
-                             cfg.load_num, cfg.run_num)
+                             cfg.load_num, cfg.run_num, cfg.coroutine_num,
+                             cfg.expected_keys, cfg.bulk_load,
+                             cfg.eadr ? "eADR" : "ADR", cfg.epoch_us,
+                             shard_dirs, cfg.live_report, cfg.target_rate,
+                             cfg.arrival, cfg.perf_counters,
+                             cfg.distribution, cfg.trace_mode,
+                             cfg.workload.c_str(), cfg.seed)
                   << "}";
     }
 };
@@ -1,6 +1,8 @@
 #ifndef PMHB_CONTEXT_HPP
 #define PMHB_CONTEXT_HPP
 
+#include "histogram.hpp"
+#include "live_report.hpp"
 #include "utils.hpp"
 #include <atomic>
 #include <list>
@@ -26,6 +28,26 @@ struct RESIZE_ITEM_NUMBER : time_slice {};
 using operation = std::variant<INSERT, SEARCH, REHASH, DOUBLE, UPDATE, DELETE,
                                RESIZE_ITEM_NUMBER, WRITE_COUNT>;
 
+/* The latencies of the operations go to histograms, only the rare events
+ * (REHASH, DOUBLE, RESIZE_ITEM_NUMBER) are kept as samples. RAW_SAMPLES
+ * keeps every operation as a sample too, for debugging. */
+#ifdef RAW_SAMPLES
+inline constexpr bool raw_samples = true;
+#else
+inline constexpr bool raw_samples = false;
+#endif
+
+/* The samples reserved per thread if the operations are not kept */
+inline constexpr size_t EVENT_RESERVED_NUM = 100'000;
+
+/* Whether an operation is an index operation rather than an event */
+inline bool is_index_op(size_t idx) {
+    return idx == operation{INSERT{}}.index() ||
+           idx == operation{SEARCH{}}.index() ||
+           idx == operation{UPDATE{}}.index() ||
+           idx == operation{DELETE{}}.index();
+}
+
 
 struct pending_list {
     std::array<std::pair<bool, operation>, 10> pending;
@@ -57,12 +79,20 @@ struct context {
     size_t tid{0};
     size_t write_count{0};
     std::vector<operation> samples{};
+    /* The latencies by the index of the operation */
+    std::array<latency_histogram, std::variant_size_v<operation>> histograms{};
+    /* The latencies from the intended start times in the open-loop mode */
+    latency_histogram response{};
+    bool open_loop{false};
+    /* The intervals of the live report */
+    live_ring *live{nullptr};
     // std::list<operation> pending{};
     pending_list pending;
 
-    /* reserved for 100 million */
+    /* reserved_num is the operations expected, only reserved with
+     * RAW_SAMPLES */
     context(size_t reserved_num = 3'000'000) {
-        samples.reserve(reserved_num);
+        samples.reserve(raw_samples ? reserved_num : EVENT_RESERVED_NUM);
         // fmt::print("capacity is {}\n", samples.capacity());
         pre_fault(samples.data(), sizeof(operation) * samples.capacity(), 4096);
     }
@@ -106,11 +136,47 @@ struct context {
                          [&](RESIZE_ITEM_NUMBER &) {}, [&](WRITE_COUNT &) {}},
 
                 match);
-        samples.push_back(std::move(match));
+        std::visit(
+                [&](time_slice const &m) {
+                    histograms[match.index()].record(m.elapsed_time.count());
+                    if (live == nullptr) { return; }
+                    if (is_index_op(match.index())) {
+                        /* The open-loop mode reports the response times */
+                        if (open_loop) { return; }
+                        live->add_latency(m.start_time + m.elapsed_time,
+                                          m.elapsed_time.count());
+                    } else {
+                        live->add_resize(m.start_time + m.elapsed_time);
+                    }
+                },
+                match);
+        if (raw_samples || !is_index_op(match.index())) {
+            samples.push_back(std::move(match));
+        }
     }
+
+    /* An open-loop command meant to start at intended is done at end */
+    void respond(time_point intended, time_point end) {
+        auto ns = (size_t) (end - intended).count();
+        response.record(ns);
+        live->add_latency(end, ns);
+    }
+
     void add_write(size_t writes) { write_count += writes; }
+
+    /* Drop what the load phase recorded */
+    void reset() {
+        samples.clear();
+        for (auto &h : histograms) { h.clear(); }
+        response.clear();
+        write_count = 0;
+    }
 };
 
+/* The context of the calling thread, bound when the thread registers with
+ * the profiler, so that sampling an operation needs no lookup */
+inline thread_local context *local_ctx = nullptr;
+
 }// namespace pmhb_ns
 
 #endif//PMHB_CONTEXT_HPP
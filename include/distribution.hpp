@@ -0,0 +1,87 @@
+#ifndef PMHB_DISTRIBUTION_HPP
+#define PMHB_DISTRIBUTION_HPP
+
+#include "utils.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace pmhb_ns {
+
+/* The commands [begin, end) of a phase a worker takes in batches. With the
+ * shared distribution the workers take them from one counter, on a cache
+ * line of its own, otherwise a worker has a contiguous partition of them. */
+struct work_partition {
+    /* Types */
+    struct alignas(64) counter {
+        std::atomic<size_t> next{0};
+    };
+
+    /* Data members */
+    counter *shared;
+    size_t begin;
+    size_t end;
+    size_t batch;
+    size_t next;
+
+    /* Constructors */
+    /* The partition of a worker out of worker_num over total commands, the
+     * counter is nullptr unless they are shared */
+    work_partition(counter *_shared, size_t total, size_t worker_id,
+                   size_t worker_num, size_t _batch)
+        : shared{_shared}, begin{_shared ? 0 : total * worker_id / worker_num},
+          end{_shared ? total : total * (worker_id + 1) / worker_num},
+          batch{_batch}, next{begin} {}
+
+    /* Interfaces */
+    /* The first command of the next batch, from end on there is none */
+    size_t take() {
+        if (shared) {
+            return shared->next.fetch_add(batch, std::memory_order_relaxed);
+        }
+        auto i = next;
+        next += batch;
+        return i;
+    }
+
+    size_t size() const { return end - begin; }
+};
+
+/* The NUMA node of the CPU the calling thread runs on, -1 if unknown */
+inline int current_node() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr)) { return -1; }
+    return (int) node;
+}
+
+/* Move the pages of a range to a node. The pages at the ends are shared
+ * with the neighbouring ranges and go to whichever range moves them last.
+ * A pool on DAX has no pages to move, so it fails there and the range stays
+ * where the namespace is. */
+inline bool place_on_node(void const *addr, size_t len, int node) {
+    static std::atomic<bool> warned{false};
+    if (node < 0 || node >= (int) (8 * sizeof(unsigned long)) || len == 0) {
+        return false;
+    }
+    auto page = (uintptr_t) sysconf(_SC_PAGESIZE);
+    auto first = (uintptr_t) addr / page * page;
+    auto last = ((uintptr_t) addr + len + page - 1) / page * page;
+    unsigned long mask = 1ul << node;
+    if (syscall(SYS_mbind, first, last - first, MPOL_BIND, &mask,
+                8 * sizeof(mask), MPOL_MF_MOVE)) {
+        if (!warned.exchange(true)) {
+            fmt::print("numa distribution: the trace stays in place ({})\n",
+                       strerror(errno));
+        }
+        return false;
+    }
+    return true;
+}
+
+}// namespace pmhb_ns
+
+#endif//PMHB_DISTRIBUTION_HPP
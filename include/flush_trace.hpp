@@ -0,0 +1,212 @@
+#ifndef PMHB_FLUSH_TRACE_HPP
+#define PMHB_FLUSH_TRACE_HPP
+
+#include <array>
+#include <cstdint>
+#include <fmt/format.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pmhb_ns {
+
+/* What a flushed range holds */
+enum class flush_kind : size_t {
+    SLOT,
+    BUCKET,
+    SEGMENT,
+    DIRECTORY,
+    METADATA,
+    LOCK,
+    LOG,
+    RECORD,
+    OTHER,
+    NUM
+};
+
+inline constexpr size_t FLUSH_KIND_NUM = (size_t) flush_kind::NUM;
+
+inline constexpr std::array<char const *, FLUSH_KIND_NUM> FLUSH_KIND_NAMES{
+        "slot", "bucket", "segment", "directory", "metadata",
+        "lock", "log",    "record",  "other"};
+
+/* The CPU flushes 64 B cache lines, the DIMM writes 256 B XPLines */
+inline constexpr size_t FLUSH_LINE_SIZE = 64;
+inline constexpr size_t XPLINE_SIZE = 256;
+/* The XPBuffer of a DIMM combines the writes to 16 KB of XPLines */
+inline constexpr size_t XPBUFFER_LINES = 64;
+
+struct flush_counts {
+    /* The persist calls and the bytes they asked for */
+    size_t flushes = 0;
+    size_t bytes = 0;
+    /* The cache lines and the XPLines the ranges cover */
+    size_t lines = 0;
+    size_t xplines = 0;
+    /* The XPLines written to the media after write combining */
+    size_t media = 0;
+
+    void merge(flush_counts const &other) {
+        flushes += other.flushes;
+        bytes += other.bytes;
+        lines += other.lines;
+        xplines += other.xplines;
+        media += other.media;
+    }
+
+    std::string information() const {
+        return fmt::format("{{\"flushes\": {}, \"bytes\": {}, \"lines\": {}, "
+                           "\"xplines\": {}, \"media\": {}, "
+                           "\"amplification\": {:.2f}}}",
+                           flushes, bytes, lines, xplines, media,
+                           bytes ? (double) media * XPLINE_SIZE / bytes : 0.0);
+    }
+};
+
+struct flush_report {
+    std::array<flush_counts, FLUSH_KIND_NUM> kinds{};
+
+    void merge(flush_report const &other) {
+        for (size_t k = 0; k < FLUSH_KIND_NUM; k++) {
+            kinds[k].merge(other.kinds[k]);
+        }
+    }
+
+    bool empty() const {
+        for (auto const &c : kinds) {
+            if (c.flushes) { return false; }
+        }
+        return true;
+    }
+
+    /* The counts of the kinds that were flushed, and the total */
+    std::string information() const {
+        std::string ret = "{";
+        flush_counts total;
+        for (size_t k = 0; k < FLUSH_KIND_NUM; k++) {
+            if (!kinds[k].flushes) { continue; }
+            total.merge(kinds[k]);
+            ret += fmt::format("\"{}\": {}, ", FLUSH_KIND_NAMES[k],
+                               kinds[k].information());
+        }
+        return ret + fmt::format("\"total\": {}}}", total.information());
+    }
+};
+
+/* The flushes of a thread. The XPLines go through a simulated XPBuffer of
+ * the thread, an LRU of XPBUFFER_LINES XPLines, and one reaches the media
+ * when it is evicted. The buffer is per thread rather than per DIMM, so the
+ * writes of other threads to the same XPLines are not combined. */
+struct flush_trace {
+    /* Types */
+    struct entry {
+        uintptr_t xpline;
+        flush_kind kind;
+        size_t used;
+    };
+
+    /* Data members */
+    std::mutex lock;
+    flush_report report;
+    std::array<entry, XPBUFFER_LINES> buffer{};
+    size_t buffered = 0;
+    size_t tick = 0;
+
+    /* Interfaces */
+    /* A range without an address, e.g. a new object the allocator
+     * persisted, is taken as aligned and not combined */
+    void add(void const *addr, size_t len, flush_kind kind) {
+        if (len == 0) { return; }
+        auto g = std::lock_guard{lock};
+        auto &c = report.kinds[(size_t) kind];
+        c.flushes++;
+        c.bytes += len;
+        if (addr == nullptr) {
+            c.lines += (len + FLUSH_LINE_SIZE - 1) / FLUSH_LINE_SIZE;
+            c.xplines += (len + XPLINE_SIZE - 1) / XPLINE_SIZE;
+            c.media += (len + XPLINE_SIZE - 1) / XPLINE_SIZE;
+            return;
+        }
+        auto first = (uintptr_t) addr;
+        auto last = first + len - 1;
+        c.lines += last / FLUSH_LINE_SIZE - first / FLUSH_LINE_SIZE + 1;
+        for (auto xp = first / XPLINE_SIZE; xp <= last / XPLINE_SIZE; xp++) {
+            c.xplines++;
+            combine(xp, kind);
+        }
+    }
+
+    /* Take the counts, the buffered XPLines are written to the media */
+    flush_report take() {
+        auto g = std::lock_guard{lock};
+        for (size_t i = 0; i < buffered; i++) {
+            report.kinds[(size_t) buffer[i].kind].media++;
+        }
+        buffered = 0;
+        return std::exchange(report, flush_report{});
+    }
+
+    /* Helper functions */
+    /* An XPLine in the buffer is combined, otherwise it takes the place of
+     * the least recently used one, which is written to the media under the
+     * kind that brought it in */
+    void combine(uintptr_t xp, flush_kind kind) {
+        tick++;
+        entry *victim = &buffer[0];
+        for (size_t i = 0; i < buffered; i++) {
+            if (buffer[i].xpline == xp) {
+                buffer[i].used = tick;
+                return;
+            }
+            if (buffer[i].used < victim->used) { victim = &buffer[i]; }
+        }
+        if (buffered < XPBUFFER_LINES) {
+            victim = &buffer[buffered++];
+        } else {
+            report.kinds[(size_t) victim->kind].media++;
+        }
+        *victim = {xp, kind, tick};
+    }
+};
+
+/* The traces of all the threads that flushed */
+struct flush_tracer {
+    /* Data members */
+    inline static std::mutex traces_lock;
+    inline static std::vector<std::unique_ptr<flush_trace>> traces;
+    inline static thread_local flush_trace *local = nullptr;
+
+    /* Interfaces */
+    static flush_trace *local_trace() {
+        if (local == nullptr) [[unlikely]] {
+            auto g = std::lock_guard{traces_lock};
+            traces.push_back(std::make_unique<flush_trace>());
+            local = traces.back().get();
+        }
+        return local;
+    }
+
+    /* Sum and clear the traces of all the threads */
+    static flush_report collect() {
+        auto g = std::lock_guard{traces_lock};
+        flush_report ret;
+        for (auto const &t : traces) { ret.merge(t->take()); }
+        return ret;
+    }
+};
+
+/* Called by the persist functions of the tables with the range they make
+ * persistent, whether it is flushed (ADR) or only fenced (eADR) */
+inline void trace_flush([[maybe_unused]] void const *addr,
+                        [[maybe_unused]] size_t len,
+                        [[maybe_unused]] flush_kind kind = flush_kind::OTHER) {
+#if defined(FLUSH_TRACE)
+    flush_tracer::local_trace()->add(addr, len, kind);
+#endif
+}
+
+}// namespace pmhb_ns
+
+#endif//PMHB_FLUSH_TRACE_HPP
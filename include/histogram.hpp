@@ -0,0 +1,102 @@
+#ifndef PMHB_HISTOGRAM_HPP
+#define PMHB_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+namespace pmhb_ns {
+
+/* A log-linear latency histogram in the manner of HdrHistogram. The values
+ * below 2^SUB_BITS have a bucket each, every power of two above is split
+ * into 2^SUB_BITS buckets, so a value is kept within 1/2^SUB_BITS of itself.
+ * A histogram has a fixed size however many values it records. */
+template<size_t SUB_BITS_>
+struct basic_histogram {
+    /* Types */
+    inline static constexpr size_t SUB_BITS = SUB_BITS_;
+    inline static constexpr size_t SUB_NUM = 1ul << SUB_BITS;
+    /* Values from 2^MAX_BITS ns, about 18 minutes, go to the last bucket */
+    inline static constexpr size_t MAX_BITS = 40;
+    inline static constexpr size_t BUCKET_NUM =
+            (MAX_BITS - SUB_BITS + 1) * SUB_NUM;
+
+    /* Data members */
+    std::array<size_t, BUCKET_NUM> counts{};
+    size_t count = 0;
+    size_t sum = 0;
+    size_t max = 0;
+
+    /* Interfaces */
+    void record(size_t v) {
+        counts[index_of(v)]++;
+        count++;
+        sum += v;
+        max = std::max(max, v);
+    }
+
+    /* Add n values of a bucket, e.g. counted elsewhere */
+    void add(size_t idx, size_t n) {
+        if (n == 0) { return; }
+        counts[idx] += n;
+        count += n;
+        sum += n * highest_of(idx);
+        max = std::max(max, highest_of(idx));
+    }
+
+    void merge(basic_histogram const &other) {
+        for (size_t i = 0; i < BUCKET_NUM; i++) { counts[i] += other.counts[i]; }
+        count += other.count;
+        sum += other.sum;
+        max = std::max(max, other.max);
+    }
+
+    void clear() { *this = basic_histogram{}; }
+
+    /* The highest value equivalent to the p-th quantile, p in (0, 1] */
+    size_t percentile(double p) const {
+        if (count == 0) { return 0; }
+        auto rank = std::max<size_t>(1, (size_t) (count * p));
+        size_t seen = 0;
+        for (size_t i = 0; i < BUCKET_NUM; i++) {
+            seen += counts[i];
+            if (seen >= rank) { return std::min(max, highest_of(i)); }
+        }
+        return max;
+    }
+
+    /* 50, 75, 90, 99, 99.9, 99.99, 99.999, 100 as gen_tail_latency */
+    std::vector<size_t> tail() const {
+        if (count == 0) { return {}; }
+        std::vector<size_t> ret;
+        for (auto p : {0.5, 0.75, 0.9, 0.99, 0.999, 0.9999, 0.99999, 1.0}) {
+            ret.push_back(percentile(p));
+        }
+        return ret;
+    }
+
+    double mean() const { return count ? (double) sum / count : 0.0; }
+
+    /* Helper functions */
+    static size_t index_of(size_t v) {
+        if (v < SUB_NUM) { return v; }
+        if (v >> MAX_BITS) { return BUCKET_NUM - 1; }
+        size_t shift = std::bit_width(v) - 1 - SUB_BITS;
+        return (shift + 1) * SUB_NUM + ((v >> shift) - SUB_NUM);
+    }
+
+    static size_t highest_of(size_t idx) {
+        if (idx < SUB_NUM) { return idx; }
+        size_t shift = idx / SUB_NUM - 1;
+        return ((SUB_NUM + idx % SUB_NUM + 1) << shift) - 1;
+    }
+};
+
+/* The operation latencies, 35 KB each */
+using latency_histogram = basic_histogram<7>;
+
+}// namespace pmhb_ns
+
+#endif//PMHB_HISTOGRAM_HPP
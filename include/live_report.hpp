@@ -0,0 +1,170 @@
+#ifndef PMHB_LIVE_REPORT_HPP
+#define PMHB_LIVE_REPORT_HPP
+
+#include "histogram.hpp"
+#include "utils.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pmhb_ns {
+
+/* The live report counts the operations per 100 ms, as the timelines */
+inline constexpr size_t LIVE_INTERVAL_NS = 100'000'000;
+/* The intervals a thread keeps, the reporter reads them 1 interval late */
+inline constexpr size_t LIVE_RING_SIZE = 16;
+
+/* Latencies within 1/8 of the value are enough for the live report */
+using live_histogram = basic_histogram<3>;
+
+/* What a thread did in one interval. Only the thread writes it, with
+ * relaxed atomics, and the reporter reads it once the interval is over */
+struct alignas(64) live_interval {
+    std::atomic<size_t> interval{~0ul};
+    std::atomic<size_t> ops{0};
+    std::atomic<size_t> resizes{0};
+    std::array<std::atomic<uint32_t>, live_histogram::BUCKET_NUM> counts{};
+};
+
+/* The ring of the last intervals of a thread */
+struct live_ring {
+    /* Data members */
+    time_point origin;
+    std::array<live_interval, LIVE_RING_SIZE> slots{};
+
+    /* Interfaces */
+    void add_ops(time_point t, size_t n) { bump(slot_of(t).ops, n); }
+
+    void add_latency(time_point t, size_t ns) {
+        bump(slot_of(t).counts[live_histogram::index_of(ns)], 1);
+    }
+
+    void add_resize(time_point t) { bump(slot_of(t).resizes, 1); }
+
+    /* Helper functions */
+    size_t interval_of(time_point t) const {
+        return t < origin ? 0 : (t - origin).count() / LIVE_INTERVAL_NS;
+    }
+
+    /* The slot of the interval of t, cleared when the interval begins */
+    live_interval &slot_of(time_point t) {
+        auto i = interval_of(t);
+        auto &s = slots[i % LIVE_RING_SIZE];
+        if (s.interval.load(std::memory_order_relaxed) != i) [[unlikely]] {
+            s.ops.store(0, std::memory_order_relaxed);
+            s.resizes.store(0, std::memory_order_relaxed);
+            for (auto &c : s.counts) { c.store(0, std::memory_order_relaxed); }
+            s.interval.store(i, std::memory_order_release);
+        }
+        return s;
+    }
+
+    template<typename T>
+    static void bump(std::atomic<T> &c, size_t n) {
+        c.store(c.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+};
+
+/* A reporter thread that sums the rings of the threads every interval. It
+ * keeps the throughput of every interval for RTTP_only and, with print,
+ * prints the throughput and latencies of the run as it goes. If it falls
+ * LIVE_RING_SIZE intervals behind, the oldest intervals are lost. */
+struct live_reporter {
+    /* Data members */
+    bool print = false;
+    time_point origin{clock::now()};
+    std::mutex ring_lock;
+    std::vector<std::unique_ptr<live_ring>> rings;
+    /* The operations of every interval, and where the run phase begins */
+    std::vector<size_t> timeline;
+    size_t run_interval = 0;
+    std::thread reporter;
+    std::atomic<bool> stop{false};
+
+    /* Interfaces */
+    void start() {
+        origin = clock::now();
+        stop = false;
+        reporter = std::thread([this] {
+            while (!stop) {
+                std::this_thread::sleep_for(
+                        std::chrono::nanoseconds(LIVE_INTERVAL_NS));
+                collect(current() > 0 ? current() - 1 : 0);
+            }
+        });
+    }
+
+    /* Stop the reporter and sum the intervals left, the threads are done */
+    void finish() {
+        if (!reporter.joinable()) { return; }
+        stop = true;
+        reporter.join();
+        collect(current() + 1);
+    }
+
+    live_ring *register_thread() {
+        auto g = std::lock_guard{ring_lock};
+        rings.push_back(std::make_unique<live_ring>());
+        rings.back()->origin = origin;
+        return rings.back().get();
+    }
+
+    void mark_run() { run_interval = current(); }
+
+    /* The throughput per second of the intervals of the run phase */
+    std::vector<size_t> run_throughput() const {
+        std::vector<size_t> ret;
+        for (size_t i = run_interval; i < timeline.size(); i++) {
+            ret.push_back(timeline[i] * (1'000'000'000 / LIVE_INTERVAL_NS));
+        }
+        return ret;
+    }
+
+    /* Helper functions */
+    size_t current() const {
+        return (clock::now() - origin).count() / LIVE_INTERVAL_NS;
+    }
+
+    /* Sum the intervals before end */
+    void collect(size_t end) {
+        auto g = std::lock_guard{ring_lock};
+        for (auto i = timeline.size(); i < end; i++) {
+            size_t ops = 0, resizes = 0;
+            live_histogram h;
+            for (auto const &r : rings) {
+                auto const &s = r->slots[i % LIVE_RING_SIZE];
+                if (s.interval.load(std::memory_order_acquire) != i) {
+                    continue;
+                }
+                ops += s.ops.load(std::memory_order_relaxed);
+                resizes += s.resizes.load(std::memory_order_relaxed);
+                for (size_t b = 0; b < live_histogram::BUCKET_NUM; b++) {
+                    h.add(b, s.counts[b].load(std::memory_order_relaxed));
+                }
+            }
+            timeline.push_back(ops);
+            if (!print) { continue; }
+            auto seconds = (double) (i + 1) * LIVE_INTERVAL_NS / 1e9;
+            auto mops = ops * (1e9 / LIVE_INTERVAL_NS) / 1e6;
+            if (h.count) {
+                fmt::print("LIVE {:.1f}s {:.3f} Mops p50 {} p99 {} p999 {} "
+                           "ns resizes {}\n",
+                           seconds, mops, h.percentile(0.5),
+                           h.percentile(0.99), h.percentile(0.999), resizes);
+            } else {
+                fmt::print("LIVE {:.1f}s {:.3f} Mops resizes {}\n", seconds,
+                           mops, resizes);
+            }
+        }
+    }
+};
+
+}// namespace pmhb_ns
+
+#endif//PMHB_LIVE_REPORT_HPP
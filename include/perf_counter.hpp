@@ -0,0 +1,153 @@
+#ifndef PMHB_PERF_COUNTER_HPP
+#define PMHB_PERF_COUNTER_HPP
+
+#include "utils.hpp"
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace pmhb_ns {
+
+/* The hardware events counted per worker and per phase */
+enum perf_event_type : size_t {
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    DTLB_MISSES,
+    STALLED_CYCLES,
+    PERF_EVENT_NUM
+};
+
+inline constexpr std::array<char const *, PERF_EVENT_NUM> PERF_EVENT_NAMES{
+        "cycles", "instructions", "llc_misses", "dtlb_misses",
+        "stalled_cycles"};
+
+/* The counts of the events, an event is absent if it could not be opened */
+struct perf_sample {
+    std::array<double, PERF_EVENT_NUM> counts{};
+    std::array<bool, PERF_EVENT_NUM> present{};
+
+    void merge(perf_sample const &other) {
+        for (size_t e = 0; e < PERF_EVENT_NUM; e++) {
+            counts[e] += other.counts[e];
+            present[e] = present[e] || other.present[e];
+        }
+    }
+
+    /* The events per operation, and the IPC */
+    std::string per_op(size_t op_num) const {
+        std::string ret = "{";
+        for (size_t e = 0; e < PERF_EVENT_NUM; e++) {
+            if (!present[e]) { continue; }
+            ret += fmt::format("{}\"{}\": {:.2f}", ret.size() > 1 ? ", " : "",
+                               PERF_EVENT_NAMES[e],
+                               counts[e] / std::max<size_t>(op_num, 1));
+        }
+        if (present[CYCLES] && present[INSTRUCTIONS] && counts[CYCLES]) {
+            ret += fmt::format(", \"ipc\": {:.3f}",
+                               counts[INSTRUCTIONS] / counts[CYCLES]);
+        }
+        return ret + "}";
+    }
+};
+
+/* The hardware counters of the calling thread, read with perf_event_open.
+ * The events are opened one by one, so that an event the CPU or the
+ * permissions do not allow is left out rather than failing the rest, and a
+ * count is scaled up if the kernel multiplexed the counter. */
+struct perf_counters {
+    /* Data members */
+    std::array<int, PERF_EVENT_NUM> fds;
+    inline static std::atomic<bool> warned{false};
+
+    /* Constructors */
+    perf_counters() { fds.fill(-1); }
+
+    ~perf_counters() {
+        for (auto fd : fds) {
+            if (fd >= 0) { ::close(fd); }
+        }
+    }
+
+    perf_counters(perf_counters const &) = delete;
+    perf_counters &operator=(perf_counters const &) = delete;
+
+    /* Interfaces */
+    /* Open the events for the calling thread, return whether any is open */
+    bool open() {
+        int err = 0;
+        for (size_t e = 0; e < PERF_EVENT_NUM; e++) {
+            auto attr = attr_of((perf_event_type) e);
+            fds[e] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fds[e] < 0) { err = errno; }
+        }
+        bool any = std::any_of(fds.begin(), fds.end(),
+                               [](int fd) { return fd >= 0; });
+        if (err && !warned.exchange(true)) {
+            fmt::print("perf counters: {} of the events unavailable ({})\n",
+                       any ? "some" : "all", strerror(err));
+        }
+        return any;
+    }
+
+    void start() {
+        for (auto fd : fds) {
+            if (fd < 0) { continue; }
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    perf_sample stop() {
+        perf_sample ret;
+        for (size_t e = 0; e < PERF_EVENT_NUM; e++) {
+            if (fds[e] < 0) { continue; }
+            ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+            /* value, time enabled, time running */
+            uint64_t v[3];
+            if (read(fds[e], v, sizeof(v)) != sizeof(v)) { continue; }
+            ret.present[e] = true;
+            ret.counts[e] = v[2] ? (double) v[0] * v[1] / v[2] : 0;
+        }
+        return ret;
+    }
+
+    /* Helper functions */
+    static perf_event_attr attr_of(perf_event_type e) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (e) {
+            case CYCLES: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case INSTRUCTIONS: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case LLC_MISSES: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+            case DTLB_MISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case STALLED_CYCLES:
+                attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+                break;
+            default: break;
+        }
+        return attr;
+    }
+};
+
+}// namespace pmhb_ns
+
+#endif//PMHB_PERF_COUNTER_HPP
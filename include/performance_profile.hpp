@@ -1,8 +1,12 @@
 #ifndef PMHB_PERFORMANCE_PROFILE
 #define PMHB_PERFORMANCE_PROFILE
 #include "context.hpp"
+#include "flush_trace.hpp"
+#include "live_report.hpp"
+#include "perf_counter.hpp"
 #include "utils.hpp"
 #include <fstream>
+#include <map>
 #include <mutex>
 #include <sstream>
 #include <string>
@@ -10,8 +14,6 @@
 #include <tuple>
 #include <vector>
 
-#define REALTIMETHROUGHPUT
-
 
 namespace pmhb_ns {
 using std::vector;
@@ -20,11 +22,39 @@ struct performance_profile {
     std::mutex record_lock;
     vector<std::pair<std::string, time_slice>> records;
     vector<double> load_factors;
+    /* The hardware counters of the workers by phase */
+    std::map<std::string, perf_sample> perf;
+    /* The traced flushes of all the threads by phase */
+    std::map<std::string, flush_report> flushes;
     // per-thread context
+    std::mutex ctx_lock;
     std::unordered_map<std::thread::id, std::shared_ptr<context>> ctxs{};
-    vector<vector<time_point>> realtime_point = vector<vector<time_point>>(48);
+    live_reporter live;
+
+    void add_perf(std::string const &phase, perf_sample const &sample) {
+        auto g = std::lock_guard(record_lock);
+        perf[phase].merge(sample);
+    }
+
+    /* Create the context of the calling thread and bind it to local_ctx,
+     * once per thread */
+    context *register_thread(size_t reserved_num) {
+        auto g = std::lock_guard{ctx_lock};
+        auto [pos, ok] = ctxs.insert({std::this_thread::get_id(), nullptr});
+        if (ok) {
+            pos->second = std::make_shared<context>(reserved_num);
+            pos->second->live = live.register_thread();
+        }
+        local_ctx = pos->second.get();
+        return local_ctx;
+    }
 };
 
+/* The profiler of the bench running a map type, for the threads the bench did
+ * not start, e.g. the background workers of a table */
+template<typename map_type>
+inline performance_profile *bench_profiler = nullptr;
+
 /* Data Classification */
 std::tuple<vector<std::pair<size_t, size_t>>, vector<std::pair<size_t, size_t>>,
            vector<std::pair<size_t, size_t>>, vector<std::pair<size_t, size_t>>,
@@ -32,7 +62,11 @@ std::tuple<vector<std::pair<size_t, size_t>>, vector<std::pair<size_t, size_t>>,
 div_ctx(std::unordered_map<std::thread::id, std::shared_ptr<context>> &ctxs) {
     vector<std::pair<size_t, size_t>> op, resize_kv_num, rehash, doubling,
             write_count;
-    op.reserve(4'000'000'000);
+    if (raw_samples) {
+        size_t sample_num = 0;
+        for (auto &[_, ctx] : ctxs) { sample_num += ctx->samples.size(); }
+        op.reserve(sample_num);
+    }
     auto visitor = overload{
             [&](INSERT &m) {
                 op.push_back({m.start_time.time_since_epoch().count(),
@@ -93,13 +127,17 @@ gen_realtime_throughput(vector<std::pair<size_t, size_t>> &op,
 
     // for ()
 
-    if (op.empty()) { return {}; }
+    if (op.empty() && resize_kv_num.empty()) { return {}; }
 
     /* Create the time line for query & involved_kv */
 
-    size_t minimal_timestamp = op.front().first;
-    size_t maximal_timestamp = op.back().first;
+    size_t minimal_timestamp = ~0ul;
+    size_t maximal_timestamp = 0;
 
+    if (op.size()) {
+        minimal_timestamp = op.front().first;
+        maximal_timestamp = op.back().first;
+    }
     if (resize_kv_num.size()) {
         minimal_timestamp =
                 std::min(minimal_timestamp, resize_kv_num.front().first);
@@ -108,8 +146,7 @@ gen_realtime_throughput(vector<std::pair<size_t, size_t>> &op,
     }
 
     size_t time_interval = (size_t) 1e8;
-    size_t N = (maximal_timestamp - minimal_timestamp + time_interval - 1) /
-               time_interval;
+    size_t N = (maximal_timestamp - minimal_timestamp) / time_interval + 1;
     vector<size_t> time_line_operation(N, 0);
     vector<size_t> time_line_kv(N, 0);
     vector<size_t> time_line_doubling(N, 0);
@@ -139,6 +176,18 @@ gen_realtime_throughput(vector<std::pair<size_t, size_t>> &op,
     return {time_line_operation, time_line_kv, time_line_doubling};
 }
 
+/* Merge the latency histograms of the threads, by operation */
+std::array<latency_histogram, std::variant_size_v<operation>> merge_histograms(
+        std::unordered_map<std::thread::id, std::shared_ptr<context>> &ctxs) {
+    std::array<latency_histogram, std::variant_size_v<operation>> ret{};
+    for (auto &[_, ctx] : ctxs) {
+        for (size_t i = 0; i < ret.size(); i++) {
+            ret[i].merge(ctx->histograms[i]);
+        }
+    }
+    return ret;
+}
+
 vector<size_t> gen_tail_latency(vector<std::pair<size_t, size_t>> &op) {
     vector<size_t> latency;
     for (auto const &[time_stamp, elasped] : op) { latency.push_back(elasped); }
@@ -190,43 +239,6 @@ void print_write_count(
     return;
 }
 
-vector<size_t>
-gen_realtime_throughput_only(vector<vector<time_point>> &realtime_point) {
-    vector<size_t> all_time_point;
-    all_time_point.reserve(1'000'000'000);
-
-    for (const auto &v : realtime_point) {
-        for (const auto &t : v) {
-            all_time_point.push_back(t.time_since_epoch().count());
-        }
-    }
-
-    sort(all_time_point.begin(), all_time_point.end());
-
-    size_t time_interval = (size_t) 1e8;
-    const size_t minimal_timestamp = all_time_point.front();
-    const size_t maximal_timestamp = all_time_point.back();
-
-    size_t N = (maximal_timestamp - minimal_timestamp + time_interval - 1) /
-               time_interval;
-    vector<size_t> time_line_operation(N, 0);
-
-    /* Increase the value of timelines */
-    for (const auto &t : all_time_point) {
-        size_t idx = (t - minimal_timestamp) / time_interval;
-        ++time_line_operation.at(idx);
-    }
-
-    /* Return the result */
-    // 每个时间点代表处理了1000个数据,与bench对应
-    for (auto &n : time_line_operation) {
-        n *= lround(1e9 / time_interval) * 1000;
-    }
-
-    return time_line_operation;
-}
-
-
 struct pm_data {
 public:
     std::vector<double> data = {0.0, 0.0, 0.0, 0.0};
@@ -0,0 +1,372 @@
+#ifndef PMHB_WORKLOAD_HPP
+#define PMHB_WORKLOAD_HPP
+
+#include "config.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace pmhb_ns {
+
+/* The workload generator follows the CoreWorkload of YCSB 0.17, so that a
+ * property file of scripts/YCSB_TRACE/workloads gives the same mix, key
+ * space and key popularity as its Java trace */
+
+inline constexpr double ZIPFIAN_CONSTANT = 0.99;
+/* The item count of the scrambled zipfian and its zeta, as YCSB has them */
+inline constexpr size_t SCRAMBLED_ITEM_COUNT = 10'000'000'000ul;
+inline constexpr double SCRAMBLED_ZETAN = 26.46902820178302;
+
+/* Utils.fnvhash64 of YCSB, the Java abs of the 64-bit FNV-1a of the bytes */
+inline int64_t fnvhash64(int64_t val) {
+    uint64_t hash = 0xCBF29CE484222325ul;
+    for (int i = 0; i < 8; i++) {
+        hash ^= val & 0xff;
+        hash *= 1099511628211ul;
+        val >>= 8;
+    }
+    auto ret = (int64_t) hash;
+    return ret < 0 ? (int64_t) (0 - hash) : ret;
+}
+
+/* The key of a record as make_command takes it out of a YCSB line: the
+ * number after "user", cut to the key length */
+inline std::string key_of(int64_t keynum, bool ordered) {
+    auto ret = std::to_string(ordered ? keynum : fnvhash64(keynum));
+    ret.resize(std::min(ret.size(), STRING_LENGTH - 1));
+    return ret;
+}
+
+/* A field value of printable characters, as the RandomByteIterator of YCSB
+ * draws it, from 64 random bits */
+inline std::string value_of(uint64_t bits) {
+    std::string ret(STRING_LENGTH - 1, ' ');
+    for (auto &c : ret) {
+        c = (char) (' ' + (bits & 63));
+        bits >>= 4;
+    }
+    return ret;
+}
+
+/* The properties of a YCSB workload file that the generator honours */
+struct workload_properties {
+    size_t recordcount = 0;
+    size_t operationcount = 0;
+    size_t insertstart = 0;
+    double readproportion = 0.95;
+    double updateproportion = 0.05;
+    double insertproportion = 0;
+    double scanproportion = 0;
+    double readmodifywriteproportion = 0;
+    std::string requestdistribution = "uniform";
+    double zipfianconstant = ZIPFIAN_CONSTANT;
+    bool ordered = false;
+
+    /* Parse the key=value lines of a Java properties file */
+    static workload_properties parse(std::filesystem::path const &path) {
+        auto f = std::ifstream{path};
+        if (!f) {
+            fmt::print("cannot open the workload {}\n", path.c_str());
+            exit(1);
+        }
+        workload_properties ret;
+        std::string line;
+        while (std::getline(f, line)) {
+            auto eq = line.find('=');
+            if (line.empty() || line[0] == '#' || eq == std::string::npos) {
+                continue;
+            }
+            auto k = trim(line.substr(0, eq));
+            auto v = trim(line.substr(eq + 1));
+            if (k == "recordcount") {
+                ret.recordcount = std::stoul(v);
+            } else if (k == "operationcount") {
+                ret.operationcount = std::stoul(v);
+            } else if (k == "insertstart") {
+                ret.insertstart = std::stoul(v);
+            } else if (k == "readproportion") {
+                ret.readproportion = std::stod(v);
+            } else if (k == "updateproportion") {
+                ret.updateproportion = std::stod(v);
+            } else if (k == "insertproportion") {
+                ret.insertproportion = std::stod(v);
+            } else if (k == "scanproportion") {
+                ret.scanproportion = std::stod(v);
+            } else if (k == "readmodifywriteproportion") {
+                ret.readmodifywriteproportion = std::stod(v);
+            } else if (k == "requestdistribution") {
+                ret.requestdistribution = v;
+            } else if (k == "zipfianconstant") {
+                ret.zipfianconstant = std::stod(v);
+            } else if (k == "insertorder") {
+                ret.ordered = v == "ordered";
+            }
+        }
+        if (ret.recordcount <= ret.insertstart) {
+            fmt::print("the workload {} has no records\n", path.c_str());
+            exit(1);
+        }
+        auto d = ret.requestdistribution;
+        if (d != "uniform" && d != "zipfian" && d != "latest") {
+            fmt::print("requestdistribution {} is not supported\n", d);
+            exit(1);
+        }
+        return ret;
+    }
+
+    static std::string trim(std::string s) {
+        auto first = s.find_first_not_of(" \t\r");
+        auto last = s.find_last_not_of(" \t\r");
+        return first == std::string::npos ? ""
+                                          : s.substr(first, last - first + 1);
+    }
+};
+
+/* Zeta(n, theta) from the sum of the first st terms */
+inline double zeta(size_t st, size_t n, double theta, double initial) {
+    double sum = initial;
+    for (size_t i = st; i < n; i++) { sum += 1 / std::pow(i + 1, theta); }
+    return sum;
+}
+
+struct uniform_generator {
+    std::uniform_int_distribution<int64_t> dist;
+
+    uniform_generator(int64_t min, int64_t max) : dist(min, max) {}
+
+    template<typename RNG>
+    int64_t next(RNG &rng) {
+        return dist(rng);
+    }
+};
+
+/* The ZipfianGenerator of YCSB over [min, min + items), from Gray et al.,
+ * "Quickly Generating Billion-Record Synthetic Databases". The item count
+ * may grow, then zeta is extended rather than computed again. */
+struct zipfian_generator {
+    /* Data members */
+    int64_t base;
+    size_t items;
+    size_t count_for_zeta;
+    double theta;
+    double zeta2theta;
+    double alpha;
+    double zetan;
+    double eta;
+    std::uniform_real_distribution<double> unit{0.0, 1.0};
+
+    /* Constructors */
+    /* zetan is the zeta of items if it is known, e.g. shared by threads */
+    zipfian_generator(int64_t min, int64_t max, double _theta,
+                      double _zetan = 0)
+        : base{min}, items((size_t) (max - min + 1)), count_for_zeta{items},
+          theta{_theta}, zeta2theta{zeta(0, 2, theta, 0)},
+          alpha{1.0 / (1.0 - theta)},
+          zetan{_zetan ? _zetan : zeta(0, items, theta, 0)},
+          eta{(1 - std::pow(2.0 / items, 1 - theta)) /
+              (1 - zeta2theta / zetan)} {}
+
+    /* Interfaces */
+    template<typename RNG>
+    int64_t next(RNG &rng) {
+        return next(rng, items);
+    }
+
+    /* The next of the first item_count items */
+    template<typename RNG>
+    int64_t next(RNG &rng, size_t item_count) {
+        if (item_count > count_for_zeta) {
+            zetan = zeta(count_for_zeta, item_count, theta, zetan);
+            count_for_zeta = item_count;
+            eta = (1 - std::pow(2.0 / items, 1 - theta)) /
+                  (1 - zeta2theta / zetan);
+        }
+        double u = unit(rng);
+        double uz = u * zetan;
+        if (uz < 1.0) { return base; }
+        if (uz < 1.0 + std::pow(0.5, theta)) { return base + 1; }
+        return base + (int64_t) (item_count *
+                                 std::pow(eta * u - eta + 1, alpha));
+    }
+};
+
+/* The zipfian of a large item space hashed onto [min, max], so the popular
+ * items are spread over the key space, as YCSB's requestdistribution=zipfian
+ * has them. The zeta of the large space is only known for the default
+ * constant, other constants hash the zipfian of [min, max] instead. */
+struct scrambled_zipfian_generator {
+    int64_t min;
+    size_t item_count;
+    zipfian_generator gen;
+
+    scrambled_zipfian_generator(int64_t _min, int64_t max, double theta)
+        : min{_min}, item_count((size_t) (max - _min + 1)),
+          gen(theta == ZIPFIAN_CONSTANT
+                      ? zipfian_generator{0, SCRAMBLED_ITEM_COUNT, theta,
+                                          SCRAMBLED_ZETAN}
+                      : zipfian_generator{0, max - _min, theta}) {}
+
+    template<typename RNG>
+    int64_t next(RNG &rng) {
+        return min + fnvhash64(gen.next(rng)) % (int64_t) item_count;
+    }
+};
+
+/* The most recently inserted records are the most popular */
+struct latest_generator {
+    zipfian_generator gen;
+
+    latest_generator(size_t record_count, double theta, double zetan)
+        : gen(0, (int64_t) record_count - 1, theta, zetan) {}
+
+    template<typename RNG>
+    int64_t next(RNG &rng, int64_t last) {
+        return last - gen.next(rng, (size_t) last);
+    }
+};
+
+/* A command of a workload, the type as the first letter of its YCSB line */
+struct workload_op {
+    char type;
+    std::string key;
+    std::string value{};
+};
+
+/* The commands of a workload, written to the trace pool by the workers
+ * before the load phase. The load commands insert the records in order and
+ * the run commands of a worker come from its own generator, seeded with the
+ * seed and the worker id, so a workload, a seed and a thread number always
+ * give the same trace. The records a worker inserts in the run phase are
+ * numbered in a stride of the thread number, and a worker only asks for
+ * the records up to its own last insert. */
+struct workload {
+    /* Types */
+    using rng_type = std::mt19937_64;
+
+    /* The run commands of a worker */
+    struct generator {
+        /* Data members */
+        workload const &w;
+        rng_type rng;
+        std::uniform_real_distribution<double> unit{0.0, 1.0};
+        uniform_generator uniform;
+        /* Made for the distribution, their zeta may take a while */
+        std::optional<scrambled_zipfian_generator> zipfian;
+        std::optional<latest_generator> latest;
+        /* The record of the next insert, and the last inserted one */
+        int64_t next_insert;
+        int64_t last_insert;
+        size_t stride;
+        /* The update of a read-modify-write is the next command */
+        std::string pending_update;
+
+        /* Constructors */
+        generator(workload const &_w, size_t worker_id, size_t worker_num)
+            : w{_w}, rng{w.seed * 1'000'003 + worker_id},
+              uniform{(int64_t) w.props.insertstart,
+                      (int64_t) (w.props.insertstart + w.insert_count) - 1},
+              next_insert{(int64_t) (w.props.recordcount + worker_id)},
+              last_insert{(int64_t) w.props.recordcount - 1},
+              stride{worker_num} {
+            auto const &p = w.props;
+            if (p.requestdistribution == "zipfian") {
+                zipfian.emplace((int64_t) p.insertstart,
+                                (int64_t) (p.insertstart + w.insert_count +
+                                           w.expected_new_keys),
+                                p.zipfianconstant);
+            } else if (p.requestdistribution == "latest") {
+                latest.emplace(p.recordcount, p.zipfianconstant,
+                               w.latest_zetan);
+            }
+        }
+
+        /* Interfaces */
+        workload_op next() {
+            if (!pending_update.empty()) {
+                return {'U', std::exchange(pending_update, {}),
+                        value_of(rng())};
+            }
+            auto const &p = w.props;
+            while (true) {
+                double op = unit(rng) * w.total_proportion;
+                if ((op -= p.readproportion) < 0) {
+                    return {'R', key_of(next_keynum(), p.ordered)};
+                }
+                if ((op -= p.updateproportion) < 0) {
+                    return {'U', key_of(next_keynum(), p.ordered),
+                            value_of(rng())};
+                }
+                if ((op -= p.insertproportion) < 0) {
+                    last_insert = next_insert;
+                    next_insert += (int64_t) stride;
+                    return {'I', key_of(last_insert, p.ordered),
+                            value_of(rng())};
+                }
+                /* pmhb has no scans, as make_command drops them */
+                if ((op -= p.scanproportion) < 0) { continue; }
+                pending_update = key_of(next_keynum(), p.ordered);
+                return {'R', pending_update};
+            }
+        }
+
+        /* Helper functions */
+        int64_t next_keynum() {
+            if (latest) { return latest->next(rng, last_insert); }
+            int64_t keynum;
+            do {
+                keynum = zipfian ? zipfian->next(rng) : uniform.next(rng);
+            } while (keynum > last_insert);
+            return keynum;
+        }
+    };
+
+    /* Data members */
+    workload_properties props;
+    size_t seed;
+    size_t insert_count;
+    size_t expected_new_keys;
+    double total_proportion;
+    double latest_zetan = 0;
+
+    /* Constructors */
+    workload(std::filesystem::path const &path, size_t _seed)
+        : props{workload_properties::parse(path)}, seed{_seed},
+          insert_count{props.recordcount - props.insertstart},
+          expected_new_keys{(size_t) (props.operationcount *
+                                      props.insertproportion * 2.0)},
+          total_proportion{props.readproportion + props.updateproportion +
+                           props.insertproportion + props.scanproportion +
+                           props.readmodifywriteproportion} {
+        if (total_proportion <= props.scanproportion) {
+            fmt::print("the workload {} has no command pmhb runs\n",
+                       path.c_str());
+            exit(1);
+        }
+        /* Shared by the latest generators of all the workers */
+        if (props.requestdistribution == "latest") {
+            latest_zetan = zeta(0, props.recordcount, props.zipfianconstant,
+                                0);
+        }
+    }
+
+    /* The key and the value of the i-th record the load phase inserts */
+    std::pair<std::string, std::string> load_record(size_t i) const {
+        /* The splitmix64 of the seed and i, as cheap as the key */
+        uint64_t z = seed + (i + 1) * 0x9E3779B97F4A7C15ul;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ul;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBul;
+        return {key_of((int64_t) (props.insertstart + i), props.ordered),
+                value_of(z ^ (z >> 31))};
+    }
+};
+
+}// namespace pmhb_ns
+
+#endif//PMHB_WORKLOAD_HPP
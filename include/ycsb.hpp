@@ -2,7 +2,9 @@
 #define PMHB_YCSB_HPP
 
 #include "config.hpp"
+#include "distribution.hpp"
 #include "varlen_kv.hpp"
+#include "workload.hpp"
 #include <atomic>
 #include <cctype>
 #include <charconv>
@@ -14,6 +16,7 @@
 #include <libpmemobj++/persistent_ptr.hpp>
 #include <libpmemobj.h>
 #include <random>
+#include <sys/mman.h>
 #include <string_view>
 #include <thread>
 #include <variant>
@@ -24,6 +27,9 @@ constexpr size_t CMD_SEGMENT_CAPACITY = 256ul << 20;
 
 constexpr size_t CMD_SEGMENT_NUM = 64;
 
+/* The commands a worker prefetches ahead of itself in a DRAM trace */
+constexpr size_t TRACE_PREFETCH_DISTANCE = 16;
+
 struct ycsb {
     /* Types */
     struct INSERT : varlen_kv {
@@ -103,12 +109,26 @@ struct ycsb {
     pmem::obj::pool<root_type> pop;
     size_t uulo = 0;
     root_type *proot;
+    /* The commands of the phases copied out of the pool, the load commands
+     * first, with trace_mode dram or hugepage. The offsets of the commands
+     * in the pool stay, the tables link to the records there. */
+    command *dram_cmds = nullptr;
+    size_t dram_num = 0;
+    size_t dram_bytes = 0;
+    std::array<size_t, CMD_SEGMENT_NUM> segment_offs{};
+    /* The workload the trace is generated from, and the pool it is in */
+    std::unique_ptr<workload> generated;
+    std::filesystem::path generated_path;
     // command *load_cmds, *run_cmds;
 
 
     /* Interfaces */
     ycsb(const config &_cfg) : cfg(_cfg) {
-        pop = pop.open(cfg.pm_ycsb.c_str(), "KV");
+        if (cfg.workload.empty()) {
+            pop = pop.open(cfg.pm_ycsb.c_str(), "KV");
+        } else {
+            create_generated();
+        }
         proot = pop.root().get();
         // load_cmds = ((command *) pmemobj_direct(proot->command_segments));
         // run_cmds = load_cmds + proot->load_cmd_num;
@@ -121,13 +141,24 @@ struct ycsb {
             exit(1);
         }
         uulo = proot->command_segments[0].pool_uuid_lo;
+        for (size_t i = 0; i < CMD_SEGMENT_NUM; i++) {
+            segment_offs[i] = proot->command_segments[i].off;
+        }
+        if (cfg.trace_mode != "pm") {
+            allocate_dram(cfg.load_num + cfg.run_num,
+                          cfg.trace_mode == "hugepage");
+        }
         fmt::print("load records {}, run records {}\n", proot->load_cmd_num,
                    proot->run_cmd_num);
         // pre_fault(load_cmds, proot->load_cmd_num * sizeof(command));
         // pre_fault(run_cmds, proot->run_cmd_num * sizeof(command));
         time_log("YCSB trace has been loaded");
     }
-    ~ycsb() { pop.close(); }
+    ~ycsb() {
+        if (dram_cmds) { munmap(dram_cmds, dram_bytes); }
+        pop.close();
+        if (generated) { std::filesystem::remove(generated_path); }
+    }
 
 
     /* Helper function */
@@ -151,17 +182,163 @@ struct ycsb {
 
 
     std::pair<command *, size_t> get_load_command(size_t idx) {
+        if (dram_cmds) { return get_dram_command(idx, idx); }
         command *pcmd = proot->get_load_cmd(idx);
         size_t off = (uintptr_t) pcmd - (uintptr_t) pop.handle();
         return {pcmd, off};
     }
 
     std::pair<command *, size_t> get_run_command(size_t idx) {
+        if (dram_cmds) {
+            return get_dram_command(cfg.load_num + idx,
+                                    proot->load_cmd_num + idx);
+        }
         command *pcmd = proot->get_run_cmd(idx);
         size_t off = (uintptr_t) pcmd - (uintptr_t) pop.handle();
         return {pcmd, off};
     }
 
+    /* Generate the commands [first, last) of a phase into the pool. The
+     * run commands are the next of the generator of the worker. */
+    void generate_commands(bool run, size_t first, size_t last,
+                           size_t worker_id) {
+        std::optional<workload::generator> gen;
+        if (run) { gen.emplace(*generated, worker_id, cfg.thread_num); }
+        size_t i = first;
+        for_segments(run, first, last, [&](command *pcmd, size_t n) {
+            for (size_t j = 0; j < n; j++, i++) {
+                if (run) {
+                    new (pcmd + j) command(make_command(gen->next()));
+                } else {
+                    auto [k, v] = generated->load_record(i);
+                    new (pcmd + j) command(INSERT(k, v));
+                }
+            }
+            pmem_persist(pcmd, n * sizeof(command));
+        });
+    }
+
+    static command make_command(workload_op const &op) {
+        if (op.type == 'R') { return READ(op.key); }
+        if (op.type == 'U') { return UPDATE(op.key, op.value); }
+        return INSERT(op.key, op.value);
+    }
+
+    /* Copy the commands [first, last) of a phase to the DRAM trace. The
+     * workers copy their partitions, so the pages are on their nodes. */
+    void stream_commands(bool run, size_t first, size_t last) {
+        auto dst = dram_cmds + first + (run ? cfg.load_num : 0);
+        for_segments(run, first, last, [&](command *pcmd, size_t n) {
+            memcpy((void *) dst, (void const *) pcmd, n * sizeof(command));
+            dst += n;
+        });
+    }
+
+    /* Move the pages of the commands [first, last) of a phase to a node,
+     * segment by segment */
+    bool place_commands(bool run, size_t first, size_t last, int node) {
+        bool ok = true;
+        for_segments(run, first, last, [&](command *pcmd, size_t n) {
+            ok = place_on_node(pcmd, n * sizeof(command), node) && ok;
+        });
+        return ok;
+    }
+
+    /* Create the pool of a generated trace next to pm_ycsb, with the
+     * segments of the commands as PM_TRACE lays them out. The workers fill
+     * it in before the load phase, and it is removed when the bench is
+     * over. */
+    void create_generated() {
+        generated = std::make_unique<workload>(cfg.workload, cfg.seed);
+        generated_path = cfg.pm_ycsb;
+        generated_path += "-" + cfg.workload.filename().string();
+        auto cmd_num = cfg.load_num + cfg.run_num;
+        auto seg_num = (cmd_num + CMD_SEGMENT_CAPACITY - 1) /
+                       CMD_SEGMENT_CAPACITY;
+        if (seg_num > CMD_SEGMENT_NUM) {
+            fmt::print("{} commands do not fit in the trace pool\n", cmd_num);
+            exit(1);
+        }
+        auto pool_size = (8ul << 20) + (size_t) (seg_num * 1.1 *
+                                                 CMD_SEGMENT_CAPACITY *
+                                                 sizeof(command));
+        std::filesystem::remove(generated_path);
+        pop = pop.create(generated_path.c_str(), "KV", pool_size, 0600);
+        auto &root = *pop.root();
+        root.load_cmd_num = cfg.load_num;
+        root.run_cmd_num = cfg.run_num;
+        for (size_t i = 0; i < seg_num; i++) {
+            if (pmemobj_alloc(pop.handle(), &root.command_segments[i],
+                              CMD_SEGMENT_CAPACITY * sizeof(command), 233,
+                              nullptr, nullptr)) {
+                fmt::print("failed to allocate the trace segment {}\n", i);
+                exit(1);
+            }
+        }
+        pmem_persist(&root, sizeof(root_type));
+        fmt::print("generating {} from {} with seed {}\n",
+                   generated_path.c_str(), cfg.workload.c_str(), cfg.seed);
+    }
+
+    /* Call f with the commands [first, last) of a phase in the pool, one
+     * contiguous run of commands per segment */
+    template<typename F>
+    void for_segments(bool run, size_t first, size_t last, F &&f) {
+        if (run) {
+            first += proot->load_cmd_num;
+            last += proot->load_cmd_num;
+        }
+        while (first < last) {
+            auto seg_idx = first / CMD_SEGMENT_CAPACITY;
+            auto seg_last =
+                    std::min(last, (seg_idx + 1) * CMD_SEGMENT_CAPACITY);
+            auto pcmd = (command *) pmemobj_direct(
+                                proot->command_segments[seg_idx]) +
+                        first % CMD_SEGMENT_CAPACITY;
+            f(pcmd, seg_last - first);
+            first = seg_last;
+        }
+    }
+
+    /* The command at idx of the DRAM trace and the offset of the command
+     * at pm_idx of the pool, computed without reading the pool */
+    std::pair<command *, size_t> get_dram_command(size_t idx, size_t pm_idx) {
+        if (idx + TRACE_PREFETCH_DISTANCE < dram_num) {
+            __builtin_prefetch(dram_cmds + idx + TRACE_PREFETCH_DISTANCE);
+        }
+        size_t off = segment_offs[pm_idx / CMD_SEGMENT_CAPACITY] +
+                     pm_idx % CMD_SEGMENT_CAPACITY * sizeof(command);
+        return {dram_cmds + idx, off};
+    }
+
+    /* Map the DRAM trace, on 2 MB pages if asked. Without reserved huge
+     * pages it asks for transparent ones instead. The pages are faulted in
+     * by the workers that copy the commands. */
+    void allocate_dram(size_t num, bool huge) {
+        dram_num = num;
+        auto page = 2ul << 20;
+        dram_bytes = (num * sizeof(command) + page - 1) / page * page;
+        void *p = MAP_FAILED;
+        if (huge) {
+            p = mmap(nullptr, dram_bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p == MAP_FAILED) {
+                fmt::print("no huge pages reserved for the trace, using "
+                           "transparent huge pages\n");
+            }
+        }
+        if (p == MAP_FAILED) {
+            p = mmap(nullptr, dram_bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                fmt::print("failed to map {} B for the trace\n", dram_bytes);
+                exit(1);
+            }
+            if (huge) { madvise(p, dram_bytes, MADV_HUGEPAGE); }
+        }
+        dram_cmds = (command *) p;
+    }
+
     static void print_command(ycsb::command const &cmd) {
         std::visit(overload{
                            [&](ycsb::INSERT const &cmd) {
@@ -6,10 +6,33 @@
 #include "adapter/level_interface.hpp"
 #include "adapter/pclht_interface.hpp"
 #include "adapter/steph_interface.hpp"
+#include "adapter/steph_sharded_interface.hpp"
+#include "adapter/steph_u64_interface.hpp"
 #include "bench.hpp"
 #include <cxxopts.hpp>
+#include <map>
 #include <string>
 
+/* Run the bench of an adapter, the bench is compiled for each of them */
+template<typename adapter_type>
+void run_bench(pmhb_ns::config const &cfg) {
+    auto b = pmhb_ns::bench<adapter_type>{cfg,
+                                          std::make_shared<adapter_type>()};
+    b.lights_out();
+}
+
+const std::map<std::string, void (*)(pmhb_ns::config const &)> schemes{
+        {"steph", run_bench<pmhb_ns::adapter::steph>},
+        {"steph_u64", run_bench<pmhb_ns::adapter::steph_u64>},
+        {"steph_sharded", run_bench<pmhb_ns::adapter::steph_sharded>},
+        {"level", run_bench<pmhb_ns::adapter::level>},
+        {"cceh", run_bench<pmhb_ns::adapter::cceh>},
+        {"cceh_cow", run_bench<pmhb_ns::adapter::cceh_cow>},
+        {"dash", run_bench<pmhb_ns::adapter::dash>},
+        {"clevel", run_bench<pmhb_ns::adapter::clevel>},
+        {"pclht", run_bench<pmhb_ns::adapter::clht>},
+};
+
 
 int main(int argc, char *argv[]) {
     auto opts =
@@ -17,7 +40,8 @@ int main(int argc, char *argv[]) {
     opts.add_options()("h,help", "Print usage")("v,verbose", "Verbose output");
     opts.add_options()("e,hash_scheme",
                        "Which hashing scheme to benchmark. Possible values: "
-                       "steph, dash, level, cceh, cceh_cow, level, clht",
+                       "steph, steph_u64, steph_sharded, dash, level, cceh, cceh_cow, level, "
+                       "clht",
                        cxxopts::value<std::string>()->default_value("steph"));
     opts.add_options()("t,thread_num", "Thread number",
                        cxxopts::value<size_t>()->default_value("1"));
@@ -50,6 +74,71 @@ int main(int argc, char *argv[]) {
                        cxxopts::value<size_t>()->default_value("100000000"));
     opts.add_options()("run_num", "Data size to run",
                        cxxopts::value<size_t>()->default_value("100000000"));
+    opts.add_options()("coroutine_num",
+                       "Lookups in flight per worker in the run phase, 0 to "
+                       "run the commands one by one",
+                       cxxopts::value<size_t>()->default_value("0"));
+    opts.add_options()("expected_keys",
+                       "Size the table for the number of keys up front, 0 to "
+                       "start small",
+                       cxxopts::value<size_t>()->default_value("0"));
+    opts.add_options()("bulk_load",
+                       "Hand the load phase over to the bulk loader of the "
+                       "table",
+                       cxxopts::value<bool>()->default_value("false"));
+    opts.add_options()("persistence_domain",
+                       "Where the stores become persistent. Possible values: "
+                       "adr (flush the caches), eadr (caches are persistent, "
+                       "fences only), auto (ask libpmem)",
+                       cxxopts::value<std::string>()->default_value("adr"));
+    opts.add_options()("epoch_us",
+                       "Persist the writes of steph at the end of epochs of "
+                       "so many microseconds, 0 to persist every write "
+                       "before it returns",
+                       cxxopts::value<size_t>()->default_value("0"));
+    opts.add_options()("shard_dirs",
+                       "Comma separated directories on the PM namespaces of "
+                       "steph_sharded, one shard each. The working directory "
+                       "if empty",
+                       cxxopts::value<std::vector<std::string>>()
+                               ->default_value(""));
+    opts.add_options()("live_report",
+                       "Print the throughput and latencies of every 100 ms "
+                       "while the benchmark runs",
+                       cxxopts::value<bool>()->default_value("false"));
+    opts.add_options()("target_rate",
+                       "Run phase in an open loop at so many operations per "
+                       "second over all threads, latencies counted from the "
+                       "intended start. 0 for a closed loop",
+                       cxxopts::value<double>()->default_value("0"));
+    opts.add_options()("arrival",
+                       "Arrivals of the open loop. Possible values: constant, "
+                       "poisson",
+                       cxxopts::value<std::string>()->default_value(
+                               "constant"));
+    opts.add_options()("perf_counters",
+                       "Count cycles, instructions, LLC and dTLB misses and "
+                       "stalled cycles per phase, reported per operation",
+                       cxxopts::value<bool>()->default_value("false"));
+    opts.add_options()("distribution",
+                       "How the workers share the commands. Possible values: "
+                       "shared (one counter), static (a contiguous partition "
+                       "each), numa (static, the partition of the trace moved "
+                       "to the node of the worker)",
+                       cxxopts::value<std::string>()->default_value("shared"));
+    opts.add_options()("trace_mode",
+                       "Where the workers read the trace. Possible values: pm "
+                       "(the pool), dram, hugepage (copied out of the pool "
+                       "before the load phase)",
+                       cxxopts::value<std::string>()->default_value("pm"));
+    opts.add_options()("workload",
+                       "Generate the trace from a YCSB property file, e.g. "
+                       "scripts/YCSB_TRACE/workloads/workloadc, instead of "
+                       "reading pm_ycsb. The pool is made next to pm_ycsb",
+                       cxxopts::value<std::filesystem::path>()->default_value(
+                               ""));
+    opts.add_options()("seed", "The seed of the generated workload",
+                       cxxopts::value<size_t>()->default_value("0"));
     opts.add_options()("R,recovery",
                        "create a new test or recover from existing pools",
                        cxxopts::value<bool>()->default_value("false"));
@@ -59,52 +148,71 @@ int main(int argc, char *argv[]) {
         return 0;
     }
 
+    auto domain = args["persistence_domain"].as<std::string>();
+    if (domain != "adr" && domain != "eadr" && domain != "auto") {
+        std::cout << opts.help() << std::endl;
+        return 0;
+    }
+    auto arrival = args["arrival"].as<std::string>();
+    if (arrival != "constant" && arrival != "poisson") {
+        std::cout << opts.help() << std::endl;
+        return 0;
+    }
+    auto distribution = args["distribution"].as<std::string>();
+    if (distribution != "shared" && distribution != "static" &&
+        distribution != "numa") {
+        std::cout << opts.help() << std::endl;
+        return 0;
+    }
+    auto trace_mode = args["trace_mode"].as<std::string>();
+    if (trace_mode != "pm" && trace_mode != "dram" &&
+        trace_mode != "hugepage") {
+        std::cout << opts.help() << std::endl;
+        return 0;
+    }
+    auto eadr = domain == "eadr" ||
+                (domain == "auto" && pmem_has_auto_flush() == 1);
+
+    auto shard_dirs = std::vector<std::filesystem::path>{};
+    for (auto const &dir : args["shard_dirs"].as<std::vector<std::string>>()) {
+        if (!dir.empty()) { shard_dirs.emplace_back(dir); }
+    }
 
     auto cfg = pmhb_ns::config{
             args["recovery"].as<bool>(),
             args["thread_num"].as<size_t>(),
             args["working_dir"].as<std::filesystem::path>(),
             args["output_dir"].as<std::filesystem::path>() /
-                    fmt::format("{}-{}", args["hash_scheme"].as<std::string>(),
-                                args["thread_num"].as<size_t>()),
+                    fmt::format("{}-{}{}",
+                                args["hash_scheme"].as<std::string>(),
+                                args["thread_num"].as<size_t>(),
+                                eadr ? "-eadr" : ""),
             args["ycsb_load"].as<std::filesystem::path>(),
             args["ycsb_run"].as<std::filesystem::path>(),
             args["pm_ycsb"].as<std::filesystem::path>(),
             args["load_num"].as<size_t>(),
-            args["run_num"].as<size_t>()};
+            args["run_num"].as<size_t>(),
+            args["coroutine_num"].as<size_t>(),
+            args["expected_keys"].as<size_t>(),
+            args["bulk_load"].as<bool>(),
+            eadr,
+            args["epoch_us"].as<size_t>(),
+            shard_dirs,
+            args["live_report"].as<bool>(),
+            args["target_rate"].as<double>(),
+            arrival,
+            args["perf_counters"].as<bool>(),
+            distribution,
+            trace_mode,
+            args["workload"].as<std::filesystem::path>(),
+            args["seed"].as<size_t>()};
 
-    auto scheme = args["hash_scheme"].as<std::string>();
-    if (scheme == "steph") {
-        auto b = pmhb_ns::bench<pmhb_ns::adapter::steph_map_type>{
-                cfg, std::make_shared<pmhb_ns::adapter::steph>()};
-        b.lights_out();
-    } else if (scheme == "level") {
-        auto b = pmhb_ns::bench<pmhb_ns::adapter::level::map_type>{
-                cfg, std::make_shared<pmhb_ns::adapter::level>()};
-        b.lights_out();
-    } else if (scheme == "cceh") {
-        auto b = pmhb_ns::bench<pmhb_ns::adapter::cceh::map_type>{
-                cfg, std::make_shared<pmhb_ns::adapter::cceh>()};
-        b.lights_out();
-    } else if (scheme == "cceh_cow") {
-        auto b = pmhb_ns::bench<pmhb_ns::adapter::cceh_cow::map_type>{
-                cfg, std::make_shared<pmhb_ns::adapter::cceh_cow>()};
-        b.lights_out();
-    } else if (scheme == "dash") {
-        auto b = pmhb_ns::bench<pmhb_ns::adapter::dash::map_type>{
-                cfg, std::make_shared<pmhb_ns::adapter::dash>()};
-        b.lights_out();
-    } else if (scheme == "clevel") {
-        auto b = pmhb_ns::bench<pmhb_ns::adapter::clevel::map_type>{
-                cfg, std::make_shared<pmhb_ns::adapter::clevel>()};
-        b.lights_out();
-    } else if (scheme == "pclht") {
-        auto b = pmhb_ns::bench<pmhb_ns::adapter::clht::map_type>{
-                cfg, std::make_shared<pmhb_ns::adapter::clht>()};
-        b.lights_out();
-    } else {
+    auto scheme = schemes.find(args["hash_scheme"].as<std::string>());
+    if (scheme == schemes.end()) {
         std::cout << opts.help() << std::endl;
+        return 0;
     }
+    scheme->second(cfg);
 
     return 0;
 }
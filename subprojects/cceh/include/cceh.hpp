@@ -130,7 +130,8 @@ struct Segment {
             memset((void *) &seg_ptr->mutex, 0, sizeof(std::shared_mutex));
             memset((void *) &seg_ptr->rwlock, 0, sizeof(PMEMrwlock));
             memset((void *) &seg_ptr->_[0], 255, sizeof(_Pair<KV>) * kNumSlot);
-            Allocator::Persist<KV>(seg_ptr, sizeof(Segment<KV>));
+            Allocator::Persist<KV>(seg_ptr, sizeof(Segment<KV>),
+                                   flush_kind::SEGMENT);
             return 0;
         };
         Allocator::Allocate(seg, kCacheLineSize, sizeof(Segment), callback,
@@ -448,7 +449,8 @@ int Segment<KV>::Insert(PMEMobjpool *pool_addr, std::string_view key,
                 _[slot].key = k_ptr;
                 _[slot].value = v_ptr;
             }
-            Allocator::Persist<KV>(&_[slot], sizeof(_Pair<KV>));
+            Allocator::Persist<KV>(&_[slot], sizeof(_Pair<KV>),
+                                   flush_kind::SLOT);
             ret = 0;
             break;
         } else {
@@ -511,10 +513,10 @@ PMEMoid *Segment<KV>::Split(PMEMobjpool *pool_addr, size_t key_hash,
 #endif
 
 #ifdef PMEM
-    Allocator::Persist<KV>(split, sizeof(Segment<KV>));
+    Allocator::Persist<KV>(split, sizeof(Segment<KV>), flush_kind::SEGMENT);
 #endif
 #ifdef PMEM
-    Allocator::Persist<KV>(this, sizeof(Segment<KV>));
+    Allocator::Persist<KV>(this, sizeof(Segment<KV>), flush_kind::SEGMENT);
 #endif
     return &log[log_pos].temp;
 }
@@ -579,7 +581,8 @@ RETRY:
         if ((dir_->_[slot].key != INVALID) &&
             (key == dir_->_[slot].key->data())) {
             dir_->_[slot].value = v_ptr;
-            Allocator::Persist<KV>(&dir_->_[slot], sizeof(_Pair<KV>));
+            Allocator::Persist<KV>(&dir_->_[slot], sizeof(_Pair<KV>),
+                                   flush_kind::SLOT);
             dir_->release_lock(pool_addr);
             return true;
         }
@@ -671,7 +674,8 @@ void CCEH<KV>::Directory_Doubling(int x, Segment<KV> *s0, PMEMoid *s1) {
 #ifdef PMEM
     Allocator::Persist<KV>(new_seg_array,
                            sizeof(Seg_array<KV>) +
-                                   sizeof(Segment<KV> *) * 2 * dir->capacity);
+                                   sizeof(Segment<KV> *) * 2 * dir->capacity,
+                                   flush_kind::DIRECTORY);
 #endif
     TX_BEGIN(pool_addr) {
         pmemobj_tx_add_range_direct(&dir->sa, sizeof(dir->sa));
@@ -708,12 +712,14 @@ void CCEH<KV>::Directory_Update(int x, Segment<KV> *s0, PMEMoid *s1) {
         if (x % 2 == 0) {
             TX_Swap((void **) &dir_entry[x + 1], s1);
 #ifdef PMEM
-            Allocator::Persist<KV>(&dir_entry[x + 1], sizeof(Segment<KV> *));
+            Allocator::Persist<KV>(&dir_entry[x + 1], sizeof(Segment<KV> *),
+                                   flush_kind::DIRECTORY);
 #endif
         } else {
             TX_Swap((void **) &dir_entry[x], s1);
 #ifdef PMEM
-            Allocator::Persist<KV>(&dir_entry[x], sizeof(Segment<KV> *));
+            Allocator::Persist<KV>(&dir_entry[x], sizeof(Segment<KV> *),
+                                   flush_kind::DIRECTORY);
 #endif
         }
     } else {
@@ -724,7 +730,8 @@ void CCEH<KV>::Directory_Update(int x, Segment<KV> *s0, PMEMoid *s1) {
         auto seg_ptr = dir_entry[x + base + base - 1];
         for (int i = base - 2; i >= 0; --i) {
             dir_entry[x + base + i] = seg_ptr;
-            Allocator::Persist<KV>(&dir_entry[x + base + i], sizeof(uint64_t));
+            Allocator::Persist<KV>(&dir_entry[x + base + i], sizeof(uint64_t),
+                                   flush_kind::DIRECTORY);
         }
     }
 }
@@ -779,7 +786,8 @@ RETRY:
                 ((key_hash >> (8 * sizeof(key_hash) - ss->local_depth + 1))
                  << 1) +
                 1;
-        Allocator::Persist<KV>(&ss->pattern, sizeof(ss->pattern));
+        Allocator::Persist<KV>(&ss->pattern, sizeof(ss->pattern),
+                               flush_kind::METADATA);
 
         // Directory management
         Lock_Directory();
@@ -800,10 +808,12 @@ RETRY:
             target->pattern =
                     (key_hash >> (8 * sizeof(key_hash) - target->local_depth))
                     << 1;
-            Allocator::Persist<KV>(&target->pattern, sizeof(target->pattern));
+            Allocator::Persist<KV>(&target->pattern, sizeof(target->pattern),
+                                   flush_kind::METADATA);
             target->local_depth += 1;
             Allocator::Persist<KV>(&target->local_depth,
-                                   sizeof(target->local_depth));
+                                   sizeof(target->local_depth),
+                                   flush_kind::METADATA);
 #ifdef INPLACE
             target->sema = 0;
             target->release_lock(pool_addr);
@@ -857,7 +867,8 @@ RETRY:
         if ((dir_->_[slot].key != INVALID) &&
             (key == dir_->_[slot].key->data())) {
             dir_->_[slot].key = INVALID;
-            Allocator::Persist<KV>(&dir_->_[slot], sizeof(_Pair<KV>));
+            Allocator::Persist<KV>(&dir_->_[slot], sizeof(_Pair<KV>),
+                                   flush_kind::SLOT);
             dir_->release_lock(pool_addr);
             return true;
         }
@@ -17,9 +17,11 @@
 #if defined PMHB_LATENCY || defined COUNTING_WRITE
 #include "../../include/sample_guard.hpp"
 #endif
+#include "../../include/flush_trace.hpp"
 
 namespace cceh_cow_ns {
 inline static const char *layout_name = "hashtable";
+using pmhb_ns::flush_kind;
 #define LOG_FATAL_CCEH_COW(msg)                                                \
     std::cout << msg << "\n";                                                  \
     exit(-1)
@@ -87,6 +89,9 @@ public:
     static Allocator *instance_;
     static Allocator *Get();
 
+    /* Caches are in the persistence domain (eADR), a fence is enough */
+    inline static bool eadr_ = false;
+
     /* Must ensure that this pointer is in persistent memory*/
     static void Allocate(void **ptr, uint32_t alignment, size_t size,
                          int (*alloc_constr)(PMEMobjpool *pool, void *ptr,
@@ -103,7 +108,8 @@ public:
     static void Persist(void *ptr, size_t size);
 
     template<typename KV>
-    static void Persist(void *ptr, size_t size);
+    static void Persist(void *ptr, size_t size,
+                        pmhb_ns::flush_kind kind = pmhb_ns::flush_kind::OTHER);
 
     static void NTWrite64(uint64_t *ptr, uint64_t val);
 
@@ -190,11 +196,20 @@ void *Allocator::GetRoot(size_t size) {
     return pmemobj_direct(pmemobj_root(instance_->pm_pool_, size));
 }
 void Allocator::Persist(void *ptr, size_t size) {
-    pmemobj_persist(instance_->pm_pool_, ptr, size);
+    if (eadr_) {
+        _mm_sfence();
+    } else {
+        pmemobj_persist(instance_->pm_pool_, ptr, size);
+    }
 }
 template<typename KV>
-void Allocator::Persist(void *ptr, size_t size) {
-    pmemobj_persist(instance_->pm_pool_, ptr, size);
+void Allocator::Persist(void *ptr, size_t size, pmhb_ns::flush_kind kind) {
+    pmhb_ns::trace_flush(ptr, size, kind);
+    if (eadr_) {
+        _mm_sfence();
+    } else {
+        pmemobj_persist(instance_->pm_pool_, ptr, size);
+    }
 #if defined(COUNTING_WRITE)
     pmhb_ns::sample_guard<CCEH_COW<KV>, pmhb_ns::WRITE_COUNT>{size};
 #endif
@@ -130,7 +130,8 @@ struct Segment {
             memset((void *) &seg_ptr->mutex, 0, sizeof(std::shared_mutex));
             memset((void *) &seg_ptr->rwlock, 0, sizeof(PMEMrwlock));
             memset((void *) &seg_ptr->_[0], 255, sizeof(_Pair<KV>) * kNumSlot);
-            Allocator::Persist<KV>(seg_ptr, sizeof(Segment<KV>));
+            Allocator::Persist<KV>(seg_ptr, sizeof(Segment<KV>),
+                                   flush_kind::SEGMENT);
             return 0;
         };
         Allocator::Allocate(seg, kCacheLineSize, sizeof(Segment), callback,
@@ -450,7 +451,8 @@ int Segment<KV>::Insert(PMEMobjpool *pool_addr, std::string_view key,
                 _[slot].key = k_ptr;
                 _[slot].value = v_ptr;
             }
-            Allocator::Persist<KV>(&_[slot], sizeof(_Pair<KV>));
+            Allocator::Persist<KV>(&_[slot], sizeof(_Pair<KV>),
+                                   flush_kind::SLOT);
             ret = 0;
             break;
         } else {
@@ -527,8 +529,8 @@ PMEMoid *Segment<KV>::Split(PMEMobjpool *pool_addr, size_t key_hash,
 #endif
 
 #ifdef PMEM
-    Allocator::Persist<KV>(split[0], sizeof(Segment<KV>));
-    Allocator::Persist<KV>(split[1], sizeof(Segment<KV>));
+    Allocator::Persist<KV>(split[0], sizeof(Segment<KV>), flush_kind::SEGMENT);
+    Allocator::Persist<KV>(split[1], sizeof(Segment<KV>), flush_kind::SEGMENT);
 #endif
     sema = 0;
 
@@ -650,7 +652,8 @@ void CCEH_COW<KV>::Directory_Doubling(int x, Segment<KV> *s0,
 #ifdef PMEM
     Allocator::Persist<KV>(new_seg_array,
                            sizeof(Seg_array<KV>) +
-                                   sizeof(Segment<KV> *) * 2 * dir->capacity);
+                                   sizeof(Segment<KV> *) * 2 * dir->capacity,
+                                   flush_kind::DIRECTORY);
 #endif
     TX_BEGIN(pool_addr) {
         pmemobj_tx_add_range_direct(&dir->sa, sizeof(dir->sa));
@@ -689,20 +692,24 @@ void CCEH_COW<KV>::Directory_Update(int x, Segment<KV> *s0,
     if (depth_diff == 1) {
         x |= 1;
         dir_entry[x] = split[1];
-        Allocator::Persist<KV>(&dir_entry[x], sizeof(Segment<KV> *));
+        Allocator::Persist<KV>(&dir_entry[x], sizeof(Segment<KV> *),
+                               flush_kind::DIRECTORY);
         dir_entry[x - 1] = split[0];
-        Allocator::Persist<KV>(&dir_entry[x - 1], sizeof(Segment<KV> *));
+        Allocator::Persist<KV>(&dir_entry[x - 1], sizeof(Segment<KV> *),
+                               flush_kind::DIRECTORY);
     } else {
         int chunk_size = pow(2, global_depth - (s0->local_depth));
         x = x - (x % chunk_size);
         int base = chunk_size / 2;
         for (int i = base - 1; i >= 0; --i) {
             dir_entry[x + base + i] = split[1];
-            Allocator::Persist<KV>(&dir_entry[x + base + i], sizeof(uint64_t));
+            Allocator::Persist<KV>(&dir_entry[x + base + i], sizeof(uint64_t),
+                                   flush_kind::DIRECTORY);
         }
         for (int i = base - 1; i >= 0; --i) {
             dir_entry[x + i] = split[0];
-            Allocator::Persist<KV>(&dir_entry[x + i], sizeof(uint64_t));
+            Allocator::Persist<KV>(&dir_entry[x + i], sizeof(uint64_t),
+                                   flush_kind::DIRECTORY);
         }
     }
 }
@@ -850,7 +857,8 @@ RETRY:
         if ((dir_->_[slot].key != INVALID) &&
             (key == dir_->_[slot].key->data())) {
             dir_->_[slot].value = v_ptr;
-            Allocator::Persist<KV>(&dir_->_[slot], sizeof(_Pair<KV>));
+            Allocator::Persist<KV>(&dir_->_[slot], sizeof(_Pair<KV>),
+                                   flush_kind::SLOT);
             dir_->release_lock(pool_addr);
             return true;
         }
@@ -897,7 +905,8 @@ RETRY:
         if ((dir_->_[slot].key != INVALID) &&
             (key == dir_->_[slot].key->data())) {
             dir_->_[slot].key = INVALID;
-            Allocator::Persist<KV>(&dir_->_[slot], sizeof(_Pair<KV>));
+            Allocator::Persist<KV>(&dir_->_[slot], sizeof(_Pair<KV>),
+                                   flush_kind::SLOT);
             dir_->release_lock(pool_addr);
             return true;
         }
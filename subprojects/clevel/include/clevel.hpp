@@ -46,6 +46,7 @@
 #include "util.hpp"
 
 // #include "polymorphic_string.hpp"
+#include "../../include/flush_trace.hpp"
 #if defined PMHB_LATENCY || defined COUNTING_WRITE
 #include "../../include/sample_guard.hpp"
 #endif
@@ -68,6 +69,14 @@
 namespace clevel_ns {
 
 using namespace pmem::obj;
+using pmhb_ns::flush_kind;
+
+/* Persist a range of the pool and trace it */
+inline void persist(pool_base &pop, const void *addr, size_t len,
+                    flush_kind kind) {
+    pop.persist(addr, len);
+    pmhb_ns::trace_flush(addr, len, kind);
+}
 
 
 #if !LIBPMEMOBJ_CPP_USE_TBB_RW_MUTEX
@@ -305,6 +314,8 @@ public:
 #ifdef WRITE_KV
         const value_type *v = static_cast<const value_type *>(param);
         internal::make_persistent_object<value_type>(pop, KV_ptr, *v);
+        pmhb_ns::trace_flush(KV_ptr.get(), sizeof(value_type),
+                             flush_kind::RECORD);
         add_count_write(sizeof(value_type));
 #endif
     }
@@ -316,6 +327,8 @@ public:
         const value_type *v = static_cast<const value_type *>(param);
         internal::make_persistent_object<value_type>(
                 pop, KV_ptr, std::move(*const_cast<value_type *>(v)));
+        pmhb_ns::trace_flush(KV_ptr.get(), sizeof(value_type),
+                             flush_kind::RECORD);
 #endif
 #ifdef COUNTING_WRITE
         add_count_write(sizeof(value_type));
@@ -584,7 +597,7 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::del_dup(
         // 1. Refer to the same location
         if (e1.get_offset() == e2.get_offset()) {
             if (CLEVEL_CAS(&(p2->p.off), e2.raw(), 0)) {
-                pop.persist(&(p2->p.off), sizeof(uint64_t));
+                persist(pop, &(p2->p.off), sizeof(uint64_t), flush_kind::SLOT);
                 add_count_write(sizeof(uint64_t));
             }
         }
@@ -593,7 +606,7 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::del_dup(
         else if (key_equal{}(e1.get_address(kv_pool_uuid)->first,
                              e1.get_address(kv_pool_uuid)->first)) {
             if (CLEVEL_CAS(&(p2->p.off), e2.raw(), 0)) {
-                pop.persist(&(p2->p.off), sizeof(uint64_t));
+                persist(pop, &(p2->p.off), sizeof(uint64_t), flush_kind::SLOT);
                 add_count_write(sizeof(uint64_t));
 
                 PMEMoid oid = e2.raw_ptr(kv_pool_uuid);
@@ -683,7 +696,7 @@ clevel_hash<Key, T, Hash, KeyEqual, HashPower>::find_empty_slot(
             return result;
         } else {
             m_copy = meta;
-            pop.persist(&(meta.off), sizeof(uint64_t));
+            persist(pop, &(meta.off), sizeof(uint64_t), flush_kind::METADATA);
             add_count_write(sizeof(uint64_t));
         }
     }
@@ -903,7 +916,7 @@ clevel_hash<Key, T, Hash, KeyEqual, HashPower>::find(
             return result;
         } else {
             m_copy = meta;
-            pop.persist(&(meta.off), sizeof(uint64_t));
+            persist(pop, &(meta.off), sizeof(uint64_t), flush_kind::METADATA);
             add_count_write(sizeof(uint64_t));
         }
     }// end while
@@ -957,7 +970,7 @@ clevel_hash<Key, T, Hash, KeyEqual, HashPower>::generic_insert(
         time_guard tg1("Try once", tg);
 #endif
         level_meta_ptr_t m_copy(meta);
-        pop.persist(&(meta.off), sizeof(uint64_t));
+        persist(pop, &(meta.off), sizeof(uint64_t), flush_kind::METADATA);
         add_count_write(sizeof(uint64_t));
 
         size_type n_levels;
@@ -997,12 +1010,14 @@ clevel_hash<Key, T, Hash, KeyEqual, HashPower>::generic_insert(
                         // Resizing may occur during the insert. Hence, redo the
                         // insertion to avoid missing the new item. The possible
                         // duplication will be fixed in future updates and deletes.
-                        pop.persist(&(meta.off), sizeof(uint64_t));
+                        persist(pop, &(meta.off), sizeof(uint64_t),
+                                flush_kind::METADATA);
                         add_count_write(sizeof(uint64_t));
                         check_duplicate = false;
                         goto RETRY_INSERT;
                     } else {
-                        pop.persist(&(e->off), sizeof(uint64_t));
+                        persist(pop, &(e->off), sizeof(uint64_t),
+                                flush_kind::SLOT);
                         add_count_write(sizeof(uint64_t));
 
                         return ret(expanded_flag, initial_capacity);
@@ -1062,8 +1077,8 @@ clevel_hash<Key, T, Hash, KeyEqual, HashPower>::erase(const key_type &key,
                     if (key_equal{}(tmp.p.get_address(kv_pool_uuid)->first,
                                     key)) {
                         if (CLEVEL_CAS(&(f_b.slots[j].p.off), tmp.p.off, 0)) {
-                            pop.persist(&(f_b.slots[j].p.off),
-                                        sizeof(uint64_t));
+                            persist(pop, &(f_b.slots[j].p.off),
+                                    sizeof(uint64_t), flush_kind::SLOT);
                             add_count_write(sizeof(uint64_t));
                             succ_deletion = true;
 
@@ -1097,8 +1112,8 @@ clevel_hash<Key, T, Hash, KeyEqual, HashPower>::erase(const key_type &key,
                     if (key_equal{}(tmp.p.get_address(kv_pool_uuid)->first,
                                     key)) {
                         if (CLEVEL_CAS(&(s_b.slots[j].p.off), tmp.p.off, 0)) {
-                            pop.persist(&(s_b.slots[j].p.off),
-                                        sizeof(uint64_t));
+                            persist(pop, &(s_b.slots[j].p.off),
+                                    sizeof(uint64_t), flush_kind::SLOT);
                             add_count_write(sizeof(uint64_t));
                             succ_deletion = true;
 
@@ -1174,7 +1189,7 @@ clevel_hash<Key, T, Hash, KeyEqual, HashPower>::generic_update(
     bool succ_update = false;
     while (true) {
         level_meta_ptr_t m_copy(meta);
-        pop.persist(&(meta.off), sizeof(uint64_t));
+        persist(pop, &(meta.off), sizeof(uint64_t), flush_kind::METADATA);
         add_count_write(sizeof(uint64_t));
 
         size_type n_levels;
@@ -1194,7 +1209,7 @@ clevel_hash<Key, T, Hash, KeyEqual, HashPower>::generic_update(
                 // which indicates a successful update.
                 return ret(true);
             } else if (CLEVEL_CAS(&(e->off), old_e.raw(), created.p.raw())) {
-                pop.persist(&(e->off), sizeof(uint64_t));
+                persist(pop, &(e->off), sizeof(uint64_t), flush_kind::SLOT);
                 add_count_write(sizeof(uint64_t));
                 // return ret(true);
 
@@ -1245,15 +1260,21 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::expand(
         size_type new_capacity = cl->capacity * 2;
         make_persistent_atomic<bucket[]>(pop, tmp_level[t_id]->buckets,
                                          new_capacity);
+        pmhb_ns::trace_flush(tmp_level[t_id]->buckets.get(),
+                             sizeof(bucket) * new_capacity,
+                             flush_kind::SEGMENT);
         add_count_write(sizeof(bucket) * new_capacity);
 
-        pop.persist(tmp_level[t_id]->buckets);
+        persist(pop, &tmp_level[t_id]->buckets,
+                sizeof(tmp_level[t_id]->buckets), flush_kind::DIRECTORY);
         add_count_write(sizeof(tmp_level[t_id]->buckets));
         tmp_level[t_id]->capacity = new_capacity;
-        pop.persist(tmp_level[t_id]->capacity);
+        persist(pop, &tmp_level[t_id]->capacity,
+                sizeof(tmp_level[t_id]->capacity), flush_kind::DIRECTORY);
         add_count_write(sizeof(tmp_level[t_id]->capacity));
         tmp_level[t_id]->up = nullptr;
-        pop.persist(&(tmp_level[t_id]->up.off), sizeof(uint64_t));
+        persist(pop, &(tmp_level[t_id]->up.off), sizeof(uint64_t),
+                flush_kind::DIRECTORY);
         add_count_write(sizeof(uint64_t));
 
         // Append a new level.
@@ -1261,7 +1282,8 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::expand(
 
         if (rc == false) {
             // Ohter threads finished expanding
-            pop.persist(&(cl->up.off), sizeof(uint64_t));
+            persist(pop, &(cl->up.off), sizeof(uint64_t),
+                    flush_kind::DIRECTORY);
             add_count_write(sizeof(uint64_t));
 
             delete_persistent_atomic<bucket[]>(tmp_level[t_id]->buckets,
@@ -1270,7 +1292,7 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::expand(
             delete_persistent_atomic<level_bucket>(tmp_level[t_id]);
         }
 
-        pop.persist(&(cl->up.off), sizeof(uint64_t));
+        persist(pop, &(cl->up.off), sizeof(uint64_t), flush_kind::DIRECTORY);
         add_count_write(sizeof(uint64_t));
 
         // Update the first_level and is_resizing in the metadata.
@@ -1287,7 +1309,8 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::expand(
             }
 
             if (CLEVEL_CAS(&(meta.off), m_copy.off, tmp_meta[t_id].raw().off)) {
-                pop.persist(&(meta.off), sizeof(uint64_t));
+                persist(pop, &(meta.off), sizeof(uint64_t),
+                        flush_kind::METADATA);
                 add_count_write(sizeof(uint64_t));
                 break;
             } else {
@@ -1305,7 +1328,7 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::expand(
         }
     } else {
         // Ohter threads finished expanding
-        pop.persist(&(cl->up.off), sizeof(uint64_t));
+        persist(pop, &(cl->up.off), sizeof(uint64_t), flush_kind::DIRECTORY);
         add_count_write(sizeof(uint64_t));
 
         if (meta == m_copy) {
@@ -1326,7 +1349,8 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::expand(
 
                 if (CLEVEL_CAS(&(meta.off), m_copy.off,
                                tmp_meta[t_id].raw().off)) {
-                    pop.persist(&(meta.off), sizeof(uint64_t));
+                    persist(pop, &(meta.off), sizeof(uint64_t),
+                            flush_kind::METADATA);
                     add_count_write(sizeof(uint64_t));
                     break;
                 } else {
@@ -1360,7 +1384,7 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::resize() {
 
     while (run_expand_thread.get_ro().load()) {
         level_meta_ptr_t m_copy(meta);
-        pop.persist(&(meta.off), sizeof(uint64_t));
+        persist(pop, &(meta.off), sizeof(uint64_t), flush_kind::METADATA);
         add_count_write(sizeof(uint64_t));
 
         level_meta *m = static_cast<level_meta *>(m_copy(my_pool_uuid));
@@ -1383,7 +1407,8 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::resize() {
             for (size_type ii = 0; ii < resize_bulk; ii++) {
             RETRY_REHASH:
                 m_copy = level_meta_ptr_t(meta);
-                pop.persist(&(meta.off), sizeof(uint64_t));
+                persist(pop, &(meta.off), sizeof(uint64_t),
+                        flush_kind::METADATA);
                 add_count_write(sizeof(uint64_t));
 
                 m = static_cast<level_meta *>(m_copy(my_pool_uuid));
@@ -1415,13 +1440,13 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::resize() {
                         if (dst_tmp.get_offset() == 0) {
                             if (CLEVEL_CAS(&(dst_b1.slots[j].p.off),
                                            dst_tmp.raw(), src_tmp.raw())) {
-                                pop.persist(&(dst_b1.slots[j].p.off),
-                                            sizeof(uint64_t));
+                                persist(pop, &(dst_b1.slots[j].p.off),
+                                        sizeof(uint64_t), flush_kind::SLOT);
                                 add_count_write(sizeof(uint64_t));
 
                                 b.slots[slot_idx].p = nullptr;
-                                pop.persist(&(b.slots[slot_idx].p.off),
-                                            sizeof(uint64_t));
+                                persist(pop, &(b.slots[slot_idx].p.off),
+                                        sizeof(uint64_t), flush_kind::SLOT);
                                 add_count_write(sizeof(uint64_t));
                                 succ = true;
                                 break;
@@ -1432,13 +1457,13 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::resize() {
                         if (dst_tmp.get_offset() == 0) {
                             if (CLEVEL_CAS(&(dst_b2.slots[j].p.off),
                                            dst_tmp.raw(), src_tmp.raw())) {
-                                pop.persist(&(dst_b2.slots[j].p.off),
-                                            sizeof(uint64_t));
+                                persist(pop, &(dst_b2.slots[j].p.off),
+                                        sizeof(uint64_t), flush_kind::SLOT);
                                 add_count_write(sizeof(uint64_t));
 
                                 b.slots[slot_idx].p = nullptr;
-                                pop.persist(&(b.slots[slot_idx].p.off),
-                                            sizeof(uint64_t));
+                                persist(pop, &(b.slots[slot_idx].p.off),
+                                        sizeof(uint64_t), flush_kind::SLOT);
                                 add_count_write(sizeof(uint64_t));
                                 succ = true;
                                 break;
@@ -1473,7 +1498,8 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::resize() {
 #endif
 
                 expand_bucket = expand_bucket + 1;
-                pop.persist(expand_bucket);
+                persist(pop, &expand_bucket, sizeof(expand_bucket),
+                        flush_kind::METADATA);
                 add_count_write(sizeof(expand_bucket));
                 if (static_cast<size_type>(expand_bucket) == bl->capacity) {
                     bool rc = false;
@@ -1490,10 +1516,12 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::resize() {
 
                         if (CLEVEL_CAS(&(meta.off), m_copy.off,
                                        tmp_meta[t_id].raw().off)) {
-                            pop.persist(&(meta.off), sizeof(uint64_t));
+                            persist(pop, &(meta.off), sizeof(uint64_t),
+                                    flush_kind::METADATA);
                             add_count_write(sizeof(uint64_t));
                             expand_bucket.get_rw() = 0;
-                            pop.persist(expand_bucket);
+                            persist(pop, &expand_bucket, sizeof(expand_bucket),
+                                    flush_kind::METADATA);
                             add_count_write(sizeof(expand_bucket));
                             rc = true;
                             break;
@@ -1501,7 +1529,8 @@ void clevel_hash<Key, T, Hash, KeyEqual, HashPower>::resize() {
                             delete_persistent_atomic<level_meta>(
                                     tmp_meta[t_id]);
                             m_copy = level_meta_ptr_t(meta);
-                            pop.persist(&(meta.off), sizeof(uint64_t));
+                            persist(pop, &(meta.off), sizeof(uint64_t),
+                                    flush_kind::METADATA);
                             add_count_write(sizeof(uint64_t));
                             m = static_cast<level_meta *>(m_copy(my_pool_uuid));
                         }
@@ -59,7 +59,7 @@ public:
                           Table<KV> *old_b);
     void ShutDown() {
         clean = true;
-        Allocator::Persist<KV>(&clean, sizeof(clean));
+        Allocator::Persist<KV>(&clean, sizeof(clean), flush_kind::METADATA);
     }
     void getNumber() {
         // std::cout << "The size of the bucket is " << sizeof(struct Bucket<KV>)
@@ -227,7 +227,8 @@ void Finger_EH<KV>::Directory_Doubling(int x, Table<KV> *new_b,
 
 #ifdef PMEM
     Allocator::Persist<KV>(new_sa, sizeof(Directory<KV>) +
-                                           sizeof(uint64_t) * 2 * capacity);
+                                           sizeof(uint64_t) * 2 * capacity,
+                                           flush_kind::DIRECTORY);
     ++merge_time;
     auto old_dir = dir;
     TX_BEGIN(pool_addr) {
@@ -320,7 +321,8 @@ void Finger_EH<KV>::recoverTable(Table<KV> **target_table, size_t key_hash,
     if (target->state != 0) {
         target->pattern =
                 key_hash >> (8 * sizeof(key_hash) - target->local_depth);
-        Allocator::Persist<KV>(&target->pattern, sizeof(target->pattern));
+        Allocator::Persist<KV>(&target->pattern, sizeof(target->pattern),
+                               flush_kind::METADATA);
         Table<KV> *next_table = (Table<KV> *) pmemobj_direct(target->next);
         if (target->state == -2) {
             if (next_table->state == -3) {
@@ -338,7 +340,8 @@ void Finger_EH<KV>::recoverTable(Table<KV> **target_table, size_t key_hash,
                 Unlock_Directory();
                 /*release the lock for the target bucket and the new bucket*/
                 next_table->state = 0;
-                Allocator::Persist<KV>(&next_table->state, sizeof(int));
+                Allocator::Persist<KV>(&next_table->state, sizeof(int),
+                                       flush_kind::LOCK);
             }
         } else if (target->state == -1) {
             // if (next_table->pattern == ((target->pattern << 1) + 1)) {
@@ -350,7 +353,7 @@ void Finger_EH<KV>::recoverTable(Table<KV> **target_table, size_t key_hash,
             // LOG_FATAL("Merge triggered");
         }
         target->state = 0;
-        Allocator::Persist<KV>(&target->state, sizeof(int));
+        Allocator::Persist<KV>(&target->state, sizeof(int), flush_kind::LOCK);
     }
 
     /*Compute for all entries and clear the dirty bit*/
@@ -390,7 +393,8 @@ void Finger_EH<KV>::Recovery(PMEMobjpool *_pop) {
             dir_entry[i] = reinterpret_cast<Table<KV> *>((snapshot & tailMask) |
                                                          set_one);
         }
-        Allocator::Persist<KV>(dir_entry, sizeof(uint64_t) * length);
+        Allocator::Persist<KV>(dir_entry, sizeof(uint64_t) * length,
+                               flush_kind::DIRECTORY);
     }
 }
 
@@ -505,9 +509,9 @@ RETRY:
 
         /*release the lock for the target bucket and the new bucket*/
         new_b->state = 0;
-        Allocator::Persist<KV>(&new_b->state, sizeof(int));
+        Allocator::Persist<KV>(&new_b->state, sizeof(int), flush_kind::LOCK);
         target->state = 0;
-        Allocator::Persist<KV>(&target->state, sizeof(int));
+        Allocator::Persist<KV>(&target->state, sizeof(int), flush_kind::LOCK);
 
         Bucket<KV> *curr_bucket;
         for (int i = 0; i < kNumBucket; ++i) {
@@ -872,7 +876,8 @@ RETRY:
 #endif
         target->release_lock();
 #ifdef PMEM
-        Allocator::Persist<KV>(&target->bitmap, sizeof(target->bitmap));
+        Allocator::Persist<KV>(&target->bitmap, sizeof(target->bitmap),
+                               flush_kind::BUCKET);
 #endif
         neighbor->release_lock();
 #ifdef COUNTING
@@ -888,7 +893,8 @@ RETRY:
 #endif
         neighbor->release_lock();
 #ifdef PMEM
-        Allocator::Persist<KV>(&neighbor->bitmap, sizeof(neighbor->bitmap));
+        Allocator::Persist<KV>(&neighbor->bitmap, sizeof(neighbor->bitmap),
+                               flush_kind::BUCKET);
 #endif
         target->release_lock();
 #ifdef COUNTING
@@ -945,7 +951,8 @@ RETRY:
                     stash->release_lock();
 #ifdef PMEM
                     Allocator::Persist<KV>(&curr_stash->bitmap,
-                                           sizeof(curr_stash->bitmap));
+                                           sizeof(curr_stash->bitmap),
+                                           flush_kind::BUCKET);
 #endif
                     auto bucket_ix = BUCKET_INDEX(key_hash);
                     auto org_bucket = target_table->bucket + bucket_ix;
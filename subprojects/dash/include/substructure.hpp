@@ -156,7 +156,9 @@ struct Bucket {
         }
 
 #ifdef PMEM
-        if (flush) { Allocator::Persist<KV>(&_[slot], sizeof(_[slot])); }
+        if (flush) {
+            Allocator::Persist<KV>(&_[slot], sizeof(_[slot]), flush_kind::SLOT);
+        }
 #endif
     }
 
@@ -448,7 +450,7 @@ struct Bucket {
                 _[i].value = v_ptr;
                 // _[i].key = k_ptr;
 #ifdef PMEM
-                Allocator::Persist<KV>(&_[i], sizeof(_[i]));
+                Allocator::Persist<KV>(&_[i], sizeof(_[i]), flush_kind::SLOT);
 #endif
                 return 0;
             }
@@ -607,6 +609,9 @@ struct Directory {
             dir_ptr->global_depth =
                     static_cast<size_t>(log2(std::get<0>(*value_ptr)));
             size_t cap = std::get<0>(*value_ptr);
+            pmhb_ns::trace_flush(dir_ptr,
+                                 sizeof(Directory<KV>) + sizeof(uint64_t) * cap,
+                                 flush_kind::DIRECTORY);
             pmemobj_persist(pool, dir_ptr,
                             sizeof(Directory<KV>) + sizeof(uint64_t) * cap);
             return 0;
@@ -705,6 +710,8 @@ struct Table {
                 memset(curr_bucket, 0, 64);
             }
 
+            pmhb_ns::trace_flush(table_ptr, sizeof(Table<KV>),
+                                 flush_kind::SEGMENT);
             pmemobj_persist(pool, table_ptr, sizeof(Table<KV>));
             return 0;
         };
@@ -774,14 +781,16 @@ struct Table {
             next_neighbor->release_lock();
 #ifdef PMEM
             Allocator::Persist<KV>(&next_neighbor->bitmap,
-                                   sizeof(next_neighbor->bitmap));
+                                   sizeof(next_neighbor->bitmap),
+                                   flush_kind::BUCKET);
 #endif
             neighbor->unset_hash(displace_index);
             neighbor->Insert_displace(key, value, meta_hash, displace_index,
                                       true, k_ptr, v_ptr);
             neighbor->release_lock();
 #ifdef PMEM
-            Allocator::Persist<KV>(&neighbor->bitmap, sizeof(neighbor->bitmap));
+            Allocator::Persist<KV>(&neighbor->bitmap, sizeof(neighbor->bitmap),
+                                   flush_kind::BUCKET);
 #endif
             target->release_lock();
 #ifdef COUNTING
@@ -806,14 +815,16 @@ struct Table {
             prev_neighbor->release_lock();
 #ifdef PMEM
             Allocator::Persist<KV>(&prev_neighbor->bitmap,
-                                   sizeof(prev_neighbor->bitmap));
+                                   sizeof(prev_neighbor->bitmap),
+                                   flush_kind::BUCKET);
 #endif
             target->unset_hash(displace_index);
             target->Insert_displace(key, value, meta_hash, displace_index,
                                     false, k_ptr, v_ptr);
             target->release_lock();
 #ifdef PMEM
-            Allocator::Persist<KV>(&target->bitmap, sizeof(target->bitmap));
+            Allocator::Persist<KV>(&target->bitmap, sizeof(target->bitmap),
+                                   flush_kind::BUCKET);
 #endif
             neighbor->release_lock();
 #ifdef COUNTING
@@ -837,7 +848,8 @@ struct Table {
                 curr_bucket->Insert(key, value, meta_hash, false, k_ptr, v_ptr);
 #ifdef PMEM
                 Allocator::Persist<KV>(&curr_bucket->bitmap,
-                                       sizeof(curr_bucket->bitmap));
+                                       sizeof(curr_bucket->bitmap),
+                                       flush_kind::BUCKET);
 #endif
                 target->set_indicator(meta_hash, neighbor,
                                       (stash_pos + i) & stashMask);
@@ -861,7 +873,8 @@ struct Table {
                 curr_bucket->Insert(key, value, meta_hash, false);
 #ifdef PMEM
                 Allocator::Persist<KV>(&curr_bucket->bitmap,
-                                       sizeof(curr_bucket->bitmap));
+                                       sizeof(curr_bucket->bitmap),
+                                       flush_kind::BUCKET);
 #endif
                 target->set_indicator(meta_hash, neighbor,
                                       (stash_pos + i) & stashMask);
@@ -1039,14 +1052,16 @@ RETRY:
         target->Insert(key, value, meta_hash, false, k_ptr, v_ptr);
         target->release_lock();
 #ifdef PMEM
-        Allocator::Persist<KV>(&target->bitmap, sizeof(target->bitmap));
+        Allocator::Persist<KV>(&target->bitmap, sizeof(target->bitmap),
+                               flush_kind::BUCKET);
 #endif
         neighbor->release_lock();
     } else {
         neighbor->Insert(key, value, meta_hash, true, k_ptr, v_ptr);
         neighbor->release_lock();
 #ifdef PMEM
-        Allocator::Persist<KV>(&neighbor->bitmap, sizeof(neighbor->bitmap));
+        Allocator::Persist<KV>(&neighbor->bitmap, sizeof(neighbor->bitmap),
+                               flush_kind::BUCKET);
 #endif
         target->release_lock();
     }
@@ -1271,12 +1286,13 @@ void Table<KV>::HelpSplit(Table<KV> *next_table) {
         invalid_array[kNumBucket + i] = invalid_mask;
     }
     next_table->pattern = new_pattern;
-    Allocator::Persist<KV>(&next_table->pattern, sizeof(next_table->pattern));
+    Allocator::Persist<KV>(&next_table->pattern, sizeof(next_table->pattern),
+                           flush_kind::METADATA);
     pattern = old_pattern;
-    Allocator::Persist<KV>(&pattern, sizeof(pattern));
+    Allocator::Persist<KV>(&pattern, sizeof(pattern), flush_kind::METADATA);
 
 #ifdef PMEM
-    Allocator::Persist<KV>(next_table, sizeof(Table));
+    Allocator::Persist<KV>(next_table, sizeof(Table), flush_kind::SEGMENT);
     size_t sumBucket = kNumBucket + stashBucket;
     for (int i = 0; i < sumBucket; ++i) {
         auto curr_bucket = bucket + i;
@@ -1287,7 +1303,7 @@ void Table<KV>::HelpSplit(Table<KV> *next_table) {
         curr_bucket->bitmap = curr_bucket->bitmap - count;
     }
 
-    Allocator::Persist<KV>(this, sizeof(Table));
+    Allocator::Persist<KV>(this, sizeof(Table), flush_kind::SEGMENT);
 #endif
 }
 
@@ -1306,12 +1322,13 @@ Table<KV> *Table<KV>::Split(size_t _key_hash) {
 
     for (int i = 1; i < kNumBucket; ++i) { (bucket + i)->get_lock(); }
     state = -2; /*means the start of the split process*/
-    Allocator::Persist<KV>(&state, sizeof(state));
+    Allocator::Persist<KV>(&state, sizeof(state), flush_kind::LOCK);
     Table<KV>::New(&next, local_depth + 1, next);
     Table<KV> *next_table = reinterpret_cast<Table<KV> *>(pmemobj_direct(next));
 
     next_table->state = -2;
-    Allocator::Persist<KV>(&next_table->state, sizeof(next_table->state));
+    Allocator::Persist<KV>(&next_table->state, sizeof(next_table->state),
+                           flush_kind::LOCK);
     next_table->bucket
             ->get_lock(); /* get the first lock of the new bucket to avoid it
                  is operated(split or merge) by other threads*/
@@ -1385,12 +1402,13 @@ Table<KV> *Table<KV>::Split(size_t _key_hash) {
     /* One bucket in the new segment causes one write */
 #endif
     next_table->pattern = new_pattern;
-    Allocator::Persist<KV>(&next_table->pattern, sizeof(next_table->pattern));
+    Allocator::Persist<KV>(&next_table->pattern, sizeof(next_table->pattern),
+                           flush_kind::METADATA);
     pattern = old_pattern;
-    Allocator::Persist<KV>(&pattern, sizeof(pattern));
+    Allocator::Persist<KV>(&pattern, sizeof(pattern), flush_kind::METADATA);
 
 #ifdef PMEM
-    Allocator::Persist<KV>(next_table, sizeof(Table));
+    Allocator::Persist<KV>(next_table, sizeof(Table), flush_kind::SEGMENT);
     size_t sumBucket = kNumBucket + stashBucket;
     for (int i = 0; i < sumBucket; ++i) {
         auto curr_bucket = bucket + i;
@@ -1401,7 +1419,7 @@ Table<KV> *Table<KV>::Split(size_t _key_hash) {
         curr_bucket->bitmap = curr_bucket->bitmap - count;
     }
 
-    Allocator::Persist<KV>(this, sizeof(Table));
+    Allocator::Persist<KV>(this, sizeof(Table), flush_kind::SEGMENT);
 #endif
 
     // LOG("thread " << pthread_self() << " finished splitting " << (void *) this);
@@ -29,6 +29,7 @@ support for variable-length key by storing the pointer to the key object.
 #include "hash.hpp"
 #include "substructure.hpp"
 #include "utils.hpp"
+#include "../../include/flush_trace.hpp"
 #if defined PMHB_LATENCY || defined COUNTING_WRITE
 #include "../../include/sample_guard.hpp"
 #endif
@@ -41,6 +42,8 @@ support for variable-length key by storing the pointer to the key object.
 #define UNIQUE_CHECK 1
 namespace level_ns {
 
+using pmhb_ns::flush_kind;
+
 TOID_DECLARE(char, 123);
 template<class KV>
 struct Entry {
@@ -55,10 +58,18 @@ struct Entry {
 template<class KV>
 class LevelHashing;
 
+/* Caches are in the persistence domain (eADR), a fence is enough */
+inline bool eadr_domain = false;
+
 template<class KV>
 void Persist(PMEMobjpool *pop, const void *addr, size_t len,
-             bool dont_count = false) {
-    pmemobj_persist(pop, addr, len);
+             flush_kind kind = flush_kind::OTHER, bool dont_count = false) {
+    pmhb_ns::trace_flush(addr, len, kind);
+    if (eadr_domain) {
+        _mm_sfence();
+    } else {
+        pmemobj_persist(pop, addr, len);
+    }
 #if defined(COUNTING_WRITE)
     if (dont_count == false)
         pmhb_ns::sample_guard<LevelHashing<KV>, pmhb_ns::WRITE_COUNT>{len};
@@ -382,10 +393,11 @@ UNIQUE:
                 buckets[i][f_idx].slot[j].value = p_v;
                 buckets[i][f_idx].slot[j].key = p_k;
 
-                Persist<KV>(pop, &buckets[i][f_idx].slot[j], sizeof(Entry<KV>));
+                Persist<KV>(pop, &buckets[i][f_idx].slot[j], sizeof(Entry<KV>),
+                            flush_kind::SLOT);
                 buckets[i][f_idx].token[j] = 1;
                 Persist<KV>(pop, &buckets[i][f_idx].token[j], sizeof(uint8_t),
-                            1);
+                            flush_kind::BUCKET, true);
 #ifdef COUNTING
                 level_item_num[i]++;
 #endif
@@ -408,10 +420,11 @@ UNIQUE:
             if (buckets[i][s_idx].token[j] == 0) {
                 buckets[i][s_idx].slot[j].value = p_v;
                 buckets[i][s_idx].slot[j].key = p_k;
-                Persist<KV>(pop, &buckets[i][s_idx].slot[j], sizeof(Entry<KV>));
+                Persist<KV>(pop, &buckets[i][s_idx].slot[j], sizeof(Entry<KV>),
+                            flush_kind::SLOT);
                 buckets[i][s_idx].token[j] = 1;
                 Persist<KV>(pop, &buckets[i][s_idx].token[j], sizeof(uint8_t),
-                            1);
+                            flush_kind::BUCKET, true);
 #ifdef COUNTING
                 level_item_num[i]++;
 #endif
@@ -451,10 +464,10 @@ UNIQUE:
                     buckets[1][f_idx].slot[empty_loc].value = p_v;
                     buckets[1][f_idx].slot[empty_loc].key = p_k;
                     Persist<KV>(pop, &buckets[1][f_idx].slot[empty_loc],
-                                sizeof(Entry<KV>));
+                                sizeof(Entry<KV>), flush_kind::SLOT);
                     buckets[1][f_idx].token[empty_loc] = 1;
                     Persist<KV>(pop, &buckets[1][f_idx].token[empty_loc],
-                                sizeof(uint8_t), 1);
+                                sizeof(uint8_t), flush_kind::BUCKET, true);
 #ifdef COUNTING
                     level_item_num[1]++;
 #endif
@@ -471,10 +484,10 @@ UNIQUE:
                     buckets[1][s_idx].slot[empty_loc].value = p_v;
                     buckets[1][s_idx].slot[empty_loc].key = p_k;
                     Persist<KV>(pop, &buckets[1][s_idx].slot[empty_loc],
-                                sizeof(Entry<KV>), 1);
+                                sizeof(Entry<KV>), flush_kind::SLOT, true);
                     buckets[1][s_idx].token[empty_loc] = 1;
                     Persist<KV>(pop, &buckets[1][s_idx].token[empty_loc],
-                                sizeof(uint8_t), 1);
+                                sizeof(uint8_t), flush_kind::BUCKET, true);
 #ifdef COUNTING
                     level_item_num[1]++;
 #endif
@@ -507,7 +520,7 @@ void LevelHashing<KV>::resize(PMEMobjpool *pop) {
 
     size_t new_addr_capacity = pow(2, levels + 1);
     _old_mutex = _mutex;
-    Persist<KV>(pop, &_old_mutex, sizeof(_old_mutex));
+    Persist<KV>(pop, &_old_mutex, sizeof(_old_mutex), flush_kind::LOCK);
     nlocks = (3 * 2 * addr_capacity / 2) / locksize + 1;
     auto ret = pmemobj_zalloc(pop, &_mutex, nlocks * sizeof(PMEMrwlock),
                               TOID_TYPE_NUM(char));
@@ -548,12 +561,12 @@ void LevelHashing<KV>::resize(PMEMobjpool *pop) {
                         interim_level_buckets[f_idx].slot[j].key = key;
 #ifndef BATCH
                         Persist<KV>(pop, &interim_level_buckets[f_idx].slot[j],
-                                    sizeof(Entry<KV>));
+                                    sizeof(Entry<KV>), flush_kind::SLOT);
 #endif
                         interim_level_buckets[f_idx].token[j] = 1;
 #ifndef BATCH
                         Persist<KV>(pop, &interim_level_buckets[f_idx].token[j],
-                                    sizeof(uint8_t));
+                                    sizeof(uint8_t), flush_kind::BUCKET);
 #endif
                         insertSuccess = 1;
 #ifdef COUNTING
@@ -565,12 +578,12 @@ void LevelHashing<KV>::resize(PMEMobjpool *pop) {
                         interim_level_buckets[s_idx].slot[j].key = key;
 #ifndef BATCH
                         Persist<KV>(pop, &interim_level_buckets[s_idx].slot[j],
-                                    sizeof(Entry<KV>));
+                                    sizeof(Entry<KV>), flush_kind::SLOT);
 #endif
                         interim_level_buckets[s_idx].token[j] = 1;
 #ifndef BATCH
                         Persist<KV>(pop, &interim_level_buckets[s_idx].token[j],
-                                    sizeof(uint8_t));
+                                    sizeof(uint8_t), flush_kind::BUCKET);
 #endif
                         insertSuccess = 1;
 #ifdef COUNTING
@@ -582,8 +595,8 @@ void LevelHashing<KV>::resize(PMEMobjpool *pop) {
 
 #ifndef BATCH
                 buckets[1][old_idx].token[i] = 0;
-                Persist<KV>(pop, &buckets[1][old_idx].token[i],
-                            sizeof(uint8_t));
+                Persist<KV>(pop, &buckets[1][old_idx].token[i], sizeof(uint8_t),
+                            flush_kind::BUCKET);
 #endif
                 involved_kv++;
             }
@@ -595,9 +608,10 @@ void LevelHashing<KV>::resize(PMEMobjpool *pop) {
     }
 
 #ifdef BATCH
-    Persist<KV>(pop, &buckets[1][0], sizeof(Node<KV>) * pow(2, levels - 1));
+    Persist<KV>(pop, &buckets[1][0], sizeof(Node<KV>) * pow(2, levels - 1),
+                flush_kind::SEGMENT);
     Persist<KV>(pop, &interim_level_buckets[0],
-                sizeof(Node<KV>) * new_addr_capacity);
+                sizeof(Node<KV>) * new_addr_capacity, flush_kind::SEGMENT);
 #endif
 
     TX_BEGIN(pop) {
@@ -656,21 +670,21 @@ uint8_t LevelHashing<KV>::try_movement(PMEMobjpool *pop, uint64_t idx,
                     buckets[level_num][jdx].slot[j].value = m_value;
                     buckets[level_num][jdx].slot[j].key = m_key;
                     Persist<KV>(pop, &buckets[level_num][jdx].slot[j],
-                                sizeof(Entry<KV>));
+                                sizeof(Entry<KV>), flush_kind::SLOT);
                     buckets[level_num][jdx].token[j] = 1;
                     Persist<KV>(pop, &buckets[level_num][jdx].token[j],
-                                sizeof(uint8_t));
+                                sizeof(uint8_t), flush_kind::BUCKET);
                     buckets[level_num][idx].token[i] = 0;
                     Persist<KV>(pop, &buckets[level_num][idx].token[i],
-                                sizeof(uint8_t));
+                                sizeof(uint8_t), flush_kind::BUCKET);
 
                     buckets[level_num][idx].slot[i].value = value;
                     buckets[level_num][idx].slot[i].key = key;
                     Persist<KV>(pop, &buckets[level_num][idx].slot[i],
-                                sizeof(Entry<KV>));
+                                sizeof(Entry<KV>), flush_kind::SLOT);
                     buckets[level_num][idx].token[i] = 1;
                     Persist<KV>(pop, &buckets[level_num][idx].token[i],
-                                sizeof(uint8_t));
+                                sizeof(uint8_t), flush_kind::BUCKET);
 #ifdef COUNTING
                     level_item_num[level_num]++;
 #endif
@@ -712,11 +726,14 @@ int LevelHashing<KV>::b2t_movement(PMEMobjpool *pop, uint64_t idx) {
             if (buckets[0][f_idx].token[j] == 0) {
                 buckets[0][f_idx].slot[j].value = value;
                 buckets[0][f_idx].slot[j].key = key;
-                Persist<KV>(pop, &buckets[0][f_idx].slot[j], sizeof(Entry<KV>));
+                Persist<KV>(pop, &buckets[0][f_idx].slot[j], sizeof(Entry<KV>),
+                            flush_kind::SLOT);
                 buckets[0][f_idx].token[j] = 1;
-                Persist<KV>(pop, &buckets[0][f_idx].token[j], sizeof(uint8_t));
+                Persist<KV>(pop, &buckets[0][f_idx].token[j], sizeof(uint8_t),
+                            flush_kind::BUCKET);
                 buckets[1][idx].token[i] = 0;
-                Persist<KV>(pop, &buckets[1][idx].token[i], sizeof(uint8_t));
+                Persist<KV>(pop, &buckets[1][idx].token[i], sizeof(uint8_t),
+                            flush_kind::BUCKET);
 #ifdef COUNTING
                 level_item_num[0]++;
                 level_item_num[1]--;
@@ -733,11 +750,14 @@ int LevelHashing<KV>::b2t_movement(PMEMobjpool *pop, uint64_t idx) {
             if (buckets[0][s_idx].token[j] == 0) {
                 buckets[0][s_idx].slot[j].value = value;
                 buckets[0][s_idx].slot[j].key = key;
-                Persist<KV>(pop, &buckets[0][s_idx].slot[j], sizeof(Entry<KV>));
+                Persist<KV>(pop, &buckets[0][s_idx].slot[j], sizeof(Entry<KV>),
+                            flush_kind::SLOT);
                 buckets[0][s_idx].token[j] = 1;
-                Persist<KV>(pop, &buckets[0][s_idx].token[j], sizeof(uint8_t));
+                Persist<KV>(pop, &buckets[0][s_idx].token[j], sizeof(uint8_t),
+                            flush_kind::BUCKET);
                 buckets[1][idx].token[i] = 0;
-                Persist<KV>(pop, &buckets[0][s_idx].token[j], sizeof(uint8_t));
+                Persist<KV>(pop, &buckets[0][s_idx].token[j], sizeof(uint8_t),
+                            flush_kind::BUCKET);
 #ifdef COUNTING
                 level_item_num[0]++;
                 level_item_num[1]--;
@@ -846,7 +866,7 @@ RETRY:
                     (buckets[i][f_idx].slot[j].key->data() == key)) {
                     buckets[i][f_idx].slot[j].value = p_v;
                     Persist<KV>(pop, &buckets[i][f_idx].slot[j].value,
-                                sizeof(uint8_t));
+                                sizeof(uint8_t), flush_kind::SLOT);
                     pmemobj_rwlock_unlock(pop, &mutex[f_idx / locksize]);
                     return true;
                 }
@@ -867,7 +887,7 @@ RETRY:
                     (buckets[i][s_idx].slot[j].key->data() == key)) {
                     buckets[i][s_idx].slot[j].value = p_v;
                     Persist<KV>(pop, &buckets[i][s_idx].slot[j].value,
-                                sizeof(uint8_t));
+                                sizeof(uint8_t), flush_kind::SLOT);
                     pmemobj_rwlock_unlock(pop, &mutex[s_idx / locksize]);
                     return true;
                 }
@@ -910,7 +930,7 @@ RETRY:
                     (buckets[i][f_idx].slot[j].key->data() == key)) {
                     buckets[i][f_idx].token[j] = 0;
                     Persist<KV>(pop, &buckets[i][f_idx].token[j],
-                                sizeof(uint8_t));
+                                sizeof(uint8_t), flush_kind::BUCKET);
                     pmemobj_rwlock_unlock(pop, &mutex[f_idx / locksize]);
                     return true;
                 }
@@ -933,7 +953,7 @@ RETRY:
                     (buckets[i][s_idx].slot[j].key->data() == key)) {
                     buckets[i][s_idx].token[j] = 0;
                     Persist<KV>(pop, &buckets[i][s_idx].token[j],
-                                sizeof(uint8_t));
+                                sizeof(uint8_t), flush_kind::BUCKET);
                     pmemobj_rwlock_unlock(pop, &mutex[s_idx / locksize]);
                     return true;
                 }
@@ -38,6 +38,7 @@
 #include <type_traits>
 #include <vector>
 
+#include "../../include/flush_trace.hpp"
 #if defined PMHB_LATENCY || defined COUNTING_WRITE
 #include "../../include/sample_guard.hpp"
 #endif
@@ -99,6 +100,14 @@ static inline uint8_t tas_uint8(volatile uint8_t *addr) {
 namespace pclht_ns {
 
 using namespace pmem::obj;
+using pmhb_ns::flush_kind;
+
+/* Persist a range of the pool and trace it */
+inline void persist(pool_base &pop, const void *addr, size_t len,
+                    flush_kind kind) {
+    pop.persist(addr, len);
+    pmhb_ns::trace_flush(addr, len, kind);
+}
 
 class atomic_backoff {
     /**
@@ -278,6 +287,8 @@ public:
 
         clht_hashtable_s(uint64_t n_buckets = 0) : num_buckets(n_buckets) {
             table = make_persistent<bucket_s[]>(num_buckets);
+            pmhb_ns::trace_flush(table.get(), sizeof(bucket_s) * num_buckets,
+                                 flush_kind::SEGMENT);
             hash = num_buckets - 1;
             version = 0;
             table_tmp = nullptr;
@@ -329,6 +340,7 @@ public:
                                           int &resize) {
         persistent_ptr<bucket_s> tmp;
         make_persistent_atomic<bucket_s>(pop, tmp);
+        pmhb_ns::trace_flush(tmp.get(), sizeof(bucket_s), flush_kind::BUCKET);
 
         if (__sync_add_and_fetch(&ht_ptr->num_expands, 1) >=
             ht_ptr->num_expands_threshold)
@@ -380,6 +392,8 @@ public:
     void unlock(pool_base &pop, clht_lock_t *lock) {
         pop.drain();
         *lock = LOCK_FREE;
+        pmhb_ns::trace_flush((void const *) lock, sizeof(*lock),
+                             flush_kind::LOCK);
         add_count_write(sizeof(lock));
     }
 
@@ -478,6 +492,8 @@ public:
         if (off == 0) {
 #ifdef WRITE_KV
             allocate_KV(pop, tmp_entry, param);
+            pmhb_ns::trace_flush(tmp_entry.get(), sizeof(value_type),
+                                 flush_kind::RECORD);
             add_count_write(sizeof(value_type));
 #endif
         } else {
@@ -531,14 +547,17 @@ public:
                     kv_ptr_t &s_new = b_new(my_pool_uuid)->slots[0];
 
                     s_new.off = tmp_entry.raw().off;
-                    pop.persist(&s_new.off, sizeof(kv_ptr_t));
+                    persist(pop, &s_new.off, sizeof(kv_ptr_t),
+                            flush_kind::SLOT);
                     add_count_write(sizeof(kv_ptr_t));
                     bucket->next = b_new;
-                    pop.persist(&bucket->next.off, sizeof(bucket_ptr_t));
+                    persist(pop, &bucket->next.off, sizeof(bucket_ptr_t),
+                            flush_kind::BUCKET);
                     add_count_write(sizeof(bucket_ptr_t));
                 } else {
                     empty->off = tmp_entry.raw().off;
-                    pop.persist(&empty->off, sizeof(kv_ptr_t));
+                    persist(pop, &empty->off, sizeof(kv_ptr_t),
+                            flush_kind::SLOT);
                     add_count_write(sizeof(kv_ptr_t));
                 }
 
@@ -596,7 +615,8 @@ public:
                             bucket->slots[j].get_address(kv_pool_uuid)->first,
                             key)) {
                     bucket->slots[j].off = off;
-                    pop.persist(&bucket->slots[j].off, sizeof(kv_ptr_t));
+                    persist(pop, &bucket->slots[j].off, sizeof(kv_ptr_t),
+                            flush_kind::SLOT);
                     add_count_write(sizeof(kv_ptr_t));
 
                     unlock(pop, lock);
@@ -648,7 +668,8 @@ public:
                     pmemobj_free(&oid);
 #endif
                     bucket->slots[j] = nullptr;
-                    pop.persist(&bucket->slots[j].off, sizeof(kv_ptr_t));
+                    persist(pop, &bucket->slots[j].off, sizeof(kv_ptr_t),
+                            flush_kind::SLOT);
                     add_count_write(sizeof(kv_ptr_t));
 
                     unlock(pop, lock);
@@ -791,7 +812,8 @@ public:
 
 #if CLHT_HELP_RESIZE == 1
         ht_old->table_tmp.off = ht_tmp.raw().off;
-        pop.persist(&ht_old->table_tmp.off, sizeof(clht_hashtable_ptr_t));
+        persist(pop, &ht_old->table_tmp.off, sizeof(clht_hashtable_ptr_t),
+                flush_kind::DIRECTORY);
         add_count_write(sizeof(clht_hashtable_ptr_t));
 
         for (difference_type idx = 0;
@@ -827,10 +849,12 @@ public:
 
         // Switch to the new hash table
         ht.off = ht_tmp.raw().off;
-        pop.persist(&ht.off, sizeof(clht_hashtable_ptr_t));
+        persist(pop, &ht.off, sizeof(clht_hashtable_ptr_t),
+                flush_kind::DIRECTORY);
         add_count_write(sizeof(clht_hashtable_ptr_t));
         ht_old->table_new.off = ht_tmp.raw().off;
-        pop.persist(&ht_old->table_new.off, sizeof(clht_hashtable_ptr_t));
+        persist(pop, &ht_old->table_new.off, sizeof(clht_hashtable_ptr_t),
+                flush_kind::DIRECTORY);
         add_count_write(sizeof(clht_hashtable_ptr_t));
 
         unlock(pop, &resize_lock);
@@ -891,7 +915,8 @@ public:
                                        ->first.begin(),
                                idx);
 #endif
-                    pop.persist(&bucket->slots[j].off, sizeof(kv_ptr_t));
+                    persist(pop, &bucket->slots[j].off, sizeof(kv_ptr_t),
+                            flush_kind::SLOT);
                     add_count_write(sizeof(kv_ptr_t));
                     return true;
                 }
@@ -914,10 +939,11 @@ public:
                 fmt::print("Rehash {} to newly created bucket idx: {:x} \n",
                            s_new.get_address(kv_pool_uuid)->first.begin(), idx);
 #endif
-                pop.persist(&s_new.off, sizeof(kv_ptr_t));
+                persist(pop, &s_new.off, sizeof(kv_ptr_t), flush_kind::SLOT);
                 add_count_write(sizeof(kv_ptr_t));
                 bucket->next = b_new;
-                pop.persist(&bucket->next.off, sizeof(bucket_ptr_t));
+                persist(pop, &bucket->next.off, sizeof(bucket_ptr_t),
+                        flush_kind::BUCKET);
                 return true;
             }
 
@@ -7,6 +7,7 @@
 #include <libpmem.h>
 #include <mutex>
 
+#include "stats.hpp"
 #include "util.hpp"
 namespace steph_ns {
 
@@ -17,6 +18,8 @@ struct stack_allocator {
     size_t offset;
     std::mutex mutex;
     size_t length;
+    /* The root of the owner in its own pool, for the read-only opens */
+    size_t root_offset;
 
     stack_allocator() = delete;
     stack_allocator(stack_allocator const &) = delete;
@@ -31,12 +34,21 @@ struct stack_allocator {
         }
     }
 
-    static stack_allocator *open(char const *path, size_t len) {
+    static stack_allocator *open(char const *path, size_t len,
+                                 bool reuse = false) {
         stack_allocator *ret = nullptr;
 
         size_t mapped_len;
         int is_pmem;
-        if (std::filesystem::exists(path)) {
+        if (reuse && std::filesystem::exists(path)) {
+            /* Keep the segments for recovery */
+            fmt::print("stack_allocator opens {}\n", path);
+            if ((ret = reinterpret_cast<stack_allocator *>(pmem_map_file(
+                         path, 0, 0, 0666, &mapped_len, &is_pmem))) ==
+                nullptr) {
+                throw std::runtime_error(pmem_errormsg());
+            }
+        } else if (std::filesystem::exists(path)) {
             fmt::print("stack_allocator {} exists and has been removed ({})\n",
                        path, std::filesystem::remove(path));
             // if ((ret = reinterpret_cast<stack_allocator *>(
@@ -52,17 +64,19 @@ struct stack_allocator {
             // }
         }
 
-        fmt::print("stack_allocator creates {}\n", path);
-        if ((ret = reinterpret_cast<stack_allocator *>(
-                     pmem_map_file(path, len, PMEM_FILE_CREATE | PMEM_FILE_EXCL,
-                                   0666, &mapped_len, &is_pmem))) == nullptr) {
-            throw std::runtime_error(pmem_errormsg());
-        }
-        {
-            time_guard tg("Memset the segment pool");
-            fmt::print("pool size is {:2e}\n", (double) len);
-            /* To eliminate page fault for the segment pool */
-            pre_fault(ret, len);
+        if (ret == nullptr) {
+            fmt::print("stack_allocator creates {}\n", path);
+            if ((ret = reinterpret_cast<stack_allocator *>(pmem_map_file(
+                         path, len, PMEM_FILE_CREATE | PMEM_FILE_EXCL, 0666,
+                         &mapped_len, &is_pmem))) == nullptr) {
+                throw std::runtime_error(pmem_errormsg());
+            }
+            {
+                time_guard tg("Memset the segment pool");
+                fmt::print("pool size is {:2e}\n", (double) len);
+                /* To eliminate page fault for the segment pool */
+                pre_fault(ret, len);
+            }
         }
 
         // yet to be initialized
@@ -71,9 +85,9 @@ struct stack_allocator {
                        sizeof(T));
             ret->offset = static_cast<size_t>(std::ceil(
                     static_cast<double>(sizeof(stack_allocator)) / sizeof(T)));
-            pmem_persist(&ret->offset, sizeof(size_t));
+            persist(&ret->offset, sizeof(size_t), flush_kind::METADATA);
             strcpy(ret->magic, "STACK_ALLOCATOR");
-            pmem_persist(ret->magic, sizeof(ret->magic));
+            persist(ret->magic, sizeof(ret->magic), flush_kind::METADATA);
 
             fmt::print("allocator created");
         } else {
@@ -81,7 +95,7 @@ struct stack_allocator {
         }
 
         ret->mutex.unlock();
-        pmem_persist(&ret->mutex, sizeof(ret->mutex));
+        persist(&ret->mutex, sizeof(ret->mutex), flush_kind::LOCK);
         fmt::print(": pmem address space [{}, {}) element size {} initial "
                    "offset {} \n",
                    (void *) ret, (void *) ((char *) ret + mapped_len),
@@ -92,21 +106,26 @@ struct stack_allocator {
 
     // usage:
     // auto [addr, offset] = allocator.alloc();
-    std::tuple<T *, size_t> alloc() {
+    // or allocate n contiguous elements and get the first one
+    std::tuple<T *, size_t> alloc(size_t n = 1) {
         // auto g = std::lock_guard(mutex);
         // offset += 1;
         // size_t new_off = offset + 1;
         // __sync_bool_compare_and_swap(&offset, new_off - 1, new_off);
-        size_t tmp = __atomic_add_fetch(&offset, 1, __ATOMIC_RELAXED);
-        pmem_persist(&offset, sizeof(size_t));
-        return {reinterpret_cast<T *>(this) + tmp - 1, tmp - 1};
+        size_t tmp = __atomic_add_fetch(&offset, n, __ATOMIC_RELAXED);
+        persist(&offset, sizeof(size_t), flush_kind::METADATA);
+        stat_counters::count(SEGMENT_ALLOC, n);
+        return {reinterpret_cast<T *>(this) + tmp - n, tmp - n};
     }
 
+    /* The number of elements the pool can hold */
+    size_t capacity() const { return length / sizeof(T); }
+
     void clear() {
         // auto g = std::lock_guard(mutex);
         offset = static_cast<size_t>(std::ceil(
                 static_cast<double>(sizeof(stack_allocator)) / sizeof(T)));
-        pmem_persist(&offset, sizeof(size_t));
+        persist(&offset, sizeof(size_t), flush_kind::METADATA);
     }
 };
 }// namespace steph_ns
@@ -0,0 +1,119 @@
+#ifndef STEPH_BATCH_HPP
+#define STEPH_BATCH_HPP
+
+#include "config.hpp"
+#include "persist.hpp"
+#include "util.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <fmt/core.h>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace steph_ns {
+
+template<typename KV>
+struct kv_ptr;
+
+/* The redo log of a thread, which holds the batch it is applying. It is
+ * valid if seq is not 0 and the checksum matches */
+struct alignas(64) batch_descriptor {
+    size_t seq;
+    size_t n;
+    size_t checksum;
+    /* The KVs, whose keys are read from the records */
+    size_t offsets[BATCH_MAX_SIZE];
+};
+
+/* Multi-key batches that are atomic across a crash. The descriptor of a
+ * batch is persisted once before its slots are written, and the slots are
+ * flushed together at the end instead of one by one. recover() applies the
+ * batches still in the logs again. */
+template<typename KV>
+struct batch_log {
+    /* Data members */
+    inline static batch_descriptor *logs = nullptr;
+    inline static std::atomic<size_t> writer_num{0};
+    inline static std::atomic<size_t> seq{1};
+    inline static thread_local size_t id = ~0ul;
+    inline static thread_local bool applying = false;
+    inline static thread_local std::vector<kv_ptr<KV> *> dirty;
+
+    /* Interfaces */
+    /* Persist the descriptor of a batch, the writes that follow are
+     * persistent through it */
+    template<typename KVs>
+    static void begin(KVs const &kvs) {
+        if (id == ~0ul) { enroll(); }
+        batch_descriptor d;
+        d.seq = seq.fetch_add(1);
+        d.n = 0;
+        for (auto const &[k, pkv] : kvs) { d.offsets[d.n++] = pkv.offset; }
+        d.checksum = checksum_of(d);
+        auto len = offsetof(batch_descriptor, offsets) + d.n * sizeof(size_t);
+        memcpy_persist(&logs[id], &d, len, flush_kind::LOG);
+        add_write_counter<KV>(len);
+        applying = true;
+    }
+
+    /* CAS a slot of the batch, it is flushed by commit() */
+    static bool write(kv_ptr<KV> &slot, size_t expected, size_t desired) {
+        bool ret = slot.cas(expected, desired);
+        if (ret) { dirty.push_back(&slot); }
+        return ret;
+    }
+
+    /* Persist the slots of the batch, then retire its descriptor */
+    static void commit() {
+        for (auto slot : dirty) {
+            flush(slot, sizeof(kv_ptr<KV>), flush_kind::SLOT);
+        }
+        drain();
+        add_write_counter<KV>(dirty.size() * sizeof(kv_ptr<KV>));
+        dirty.clear();
+        logs[id].seq = 0;
+        persist(&logs[id].seq, sizeof(size_t), flush_kind::LOG);
+        applying = false;
+    }
+
+    /* Call apply(offset) on the KVs of every batch left in the logs, then
+     * retire them */
+    template<typename F>
+    static size_t roll_forward(F &&apply) {
+        size_t n = 0;
+        for (size_t i = 0; i < BATCH_THREAD_NUM; i++) {
+            auto &d = logs[i];
+            if (d.seq == 0 || d.n > BATCH_MAX_SIZE ||
+                d.checksum != checksum_of(d)) {
+                continue;
+            }
+            for (size_t j = 0; j < d.n; j++) { apply(d.offsets[j]); }
+            d.seq = 0;
+            persist(&d.seq, sizeof(size_t), flush_kind::LOG);
+            n++;
+        }
+        if (n) { fmt::print("rolled {} batches forward\n", n); }
+        return n;
+    }
+
+    /* Helper functions */
+    static void enroll() {
+        id = writer_num.fetch_add(1);
+        if (id >= BATCH_THREAD_NUM) {
+            throw std::runtime_error("too many writers for the batch logs");
+        }
+    }
+
+    static size_t checksum_of(batch_descriptor const &d) {
+        auto offsets = std::string_view{(char const *) d.offsets,
+                                        d.n * sizeof(size_t)};
+        return std::hash<std::string_view>{}(offsets) ^
+               (d.seq * 0x9e3779b97f4a7c15ul) ^ d.n;
+    }
+};
+
+}// namespace steph_ns
+
+#endif//STEPH_BATCH_HPP
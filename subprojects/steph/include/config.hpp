@@ -25,4 +25,43 @@ inline constexpr auto KV_POOL_LAYOUT = "sh";
 
 inline constexpr auto FINGERPRINT_BIT_ALIGNMENT = 8ul;
 
+/* The log-structured value heap (VALUE_HEAP) */
+inline constexpr auto VALUE_HEAP_CHUNK_SIZE = 4ul << 20;
+/* A closed chunk with less live data is cleaned */
+inline constexpr auto VALUE_HEAP_CLEAN_RATIO = 0.5;
+/* A cleaned chunk is reused after the readers are done with its records */
+inline constexpr auto VALUE_HEAP_GRACE_PERIOD_US = 100'000ul;
+
+/* The largest value updated in place in its record (INPLACE_UPDATE) */
+inline constexpr auto INPLACE_VALUE_SIZE = 16ul;
+
+/* Buffered durability, the undo entries a thread writes in an epoch before
+ * it forces the next one, and the most writer threads of a table */
+inline constexpr auto EPOCH_LOG_SIZE = 4096ul;
+inline constexpr auto EPOCH_THREAD_NUM = 64ul;
+
+/* Atomic batches, the most KVs in a batch and the most writer threads */
+inline constexpr auto BATCH_MAX_SIZE = 64ul;
+inline constexpr auto BATCH_THREAD_NUM = 64ul;
+
+/* The load factor a pre-sized table is expected to reach before a split */
+inline constexpr auto RESERVE_LOAD_FACTOR = 0.7;
+
+/* A live migration copies the keys in 2^MIGRATION_RANGE_BITS hash ranges */
+inline constexpr auto MIGRATION_RANGE_BITS = 10ul;
+
+/* A sharded table holds at most so many tables, one per NUMA node or PM
+ * namespace */
+inline constexpr auto MAX_SHARD_NUM = 4ul;
+
+/* The integer-key table (steph_u64), a bucket is 4 cache lines of pairs */
+inline constexpr auto U64_PAIR_NUM_PER_BUCKET = 16ul;
+inline constexpr auto U64_BUCKET_NUM_PER_SEGMENT = 64ul;
+inline constexpr auto SH_U64_POOL_LAYOUT = "sh_u64";
+
+/* The DRAM negative-lookup filter (BLOOM_FILTER), 2 KB per segment */
+inline constexpr auto FILTER_BIT_NUM_PER_BUCKET = 256ul;
+inline constexpr auto FILTER_PROBE_BIT_NUM = 8ul;
+inline constexpr auto FILTER_PROBE_NUM = 3ul;
+
 #endif//STEPH_CONFIG_HPP
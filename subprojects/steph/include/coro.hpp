@@ -0,0 +1,176 @@
+#ifndef STEPH_CORO_HPP
+#define STEPH_CORO_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <utility>
+#include <vector>
+
+namespace steph_ns::coro {
+
+/* The innermost suspended coroutine of the task being resumed, so a
+ * scheduler resumes the lookup itself rather than the caller awaiting it */
+inline thread_local std::coroutine_handle<> *resume_point = nullptr;
+
+template<typename T>
+struct task;
+
+namespace detail {
+template<typename T>
+struct promise_result {
+    T value{};
+    void return_value(T v) { value = std::move(v); }
+};
+
+template<>
+struct promise_result<void> {
+    void return_void() {}
+};
+}// namespace detail
+
+/* A lazily started coroutine, resumed by a scheduler or by its awaiter */
+template<typename T = void>
+struct [[nodiscard]] task {
+    /* Types */
+    struct promise_type : detail::promise_result<T> {
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<>
+            await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                return h.promise().continuation;
+            }
+            void await_resume() noexcept {}
+        };
+
+        task get_return_object() {
+            return task{std::coroutine_handle<promise_type>::from_promise(
+                    *this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        final_awaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { std::terminate(); }
+    };
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    /* Data members */
+    handle_type handle{};
+
+    /* Constructors */
+    task() = default;
+    explicit task(handle_type h) : handle(h) {}
+    task(task const &) = delete;
+    task(task &&that) noexcept : handle(std::exchange(that.handle, {})) {}
+    task &operator=(task &&that) noexcept {
+        if (this != &that) {
+            if (handle) { handle.destroy(); }
+            handle = std::exchange(that.handle, {});
+        }
+        return *this;
+    }
+    ~task() {
+        if (handle) { handle.destroy(); }
+    }
+
+    /* Interfaces */
+    bool done() const { return !handle || handle.done(); }
+    decltype(auto) result() {
+        if constexpr (!std::is_void_v<T>) { return handle.promise().value; }
+    }
+
+    /* Awaited by another task: run inline until the first suspension */
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+    decltype(auto) await_resume() { return result(); }
+};
+
+
+/* Issue a prefetch and yield to the scheduler until the line arrives */
+struct prefetch {
+    /* Data members */
+    const void *addr;
+    size_t len = 64;
+
+    /* Interfaces */
+    bool await_ready() const noexcept { return resume_point == nullptr; }
+    void await_suspend(std::coroutine_handle<> h) const noexcept {
+        for (size_t i = 0; i < len; i += 64) {
+            __builtin_prefetch((const char *) addr + i, 0, 1);
+        }
+        *resume_point = h;
+    }
+    void await_resume() const noexcept {}
+};
+
+
+/* A per-thread round-robin scheduler of a fixed number of root tasks */
+struct scheduler {
+    /* Types */
+    struct slot {
+        task<> root;
+        std::coroutine_handle<> point;
+    };
+
+    /* Data members */
+    std::vector<slot> slots;
+    size_t active = 0;
+
+    /* Constructors */
+    explicit scheduler(size_t width) : slots(width ? width : 1) {}
+    scheduler(scheduler const &) = delete;
+    ~scheduler() { drain(); }
+
+    /* Interfaces */
+    /* Start a task, waiting for a free slot if all of them are in flight */
+    void spawn(task<> t) {
+        while (active == slots.size()) { step(); }
+        for (auto &s : slots) {
+            if (s.root.done()) {
+                s.point = t.handle;
+                s.root = std::move(t);
+                ++active;
+                return;
+            }
+        }
+    }
+
+    /* Resume every task in flight once */
+    void step() {
+        auto saved = resume_point;
+        for (auto &s : slots) {
+            if (s.root.done()) { continue; }
+            resume_point = &s.point;
+            s.point.resume();
+            if (s.root.done()) {
+                s.root = {};
+                --active;
+            }
+        }
+        resume_point = saved;
+    }
+
+    void drain() {
+        while (active) { step(); }
+    }
+};
+
+
+/* Run a task to completion on the calling thread */
+template<typename T>
+decltype(auto) sync_wait(task<T> &t) {
+    auto saved = resume_point;
+    std::coroutine_handle<> point = t.handle;
+    resume_point = &point;
+    while (!t.done()) { point.resume(); }
+    resume_point = saved;
+    return t.result();
+}
+
+}// namespace steph_ns::coro
+
+#endif//STEPH_CORO_HPP
@@ -0,0 +1,265 @@
+#ifndef STEPH_EPOCH_HPP
+#define STEPH_EPOCH_HPP
+
+#include "config.hpp"
+#include "persist.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fmt/core.h>
+#include <immintrin.h>
+#include <libpmemobj.h>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <x86intrin.h>
+
+namespace steph_ns {
+
+template<typename KV>
+struct kv_ptr;
+template<typename KV>
+struct segment_ptr;
+
+/* The persistent state of the buffered durability of a table */
+struct epoch_root {
+    /* The epoch length, 0 if a write is persistent when it returns */
+    size_t interval_us;
+    /* The last epoch whose writes are all persistent */
+    size_t durable_epoch;
+    /* An undo log per writer thread */
+    PMEMoid logs;
+};
+
+/* Buffered durable linearizability for the slots of a table. A write does
+ * not flush the slot: it logs the old value with non-temporal stores and
+ * remembers the line. An epoch thread ends an epoch every interval_us: it
+ * waits for the writes of the epoch, flushes their lines and persists the
+ * epoch number. The writes of the epochs after the durable one are rolled
+ * back from the undo logs when the table is opened again.
+ *
+ * A split persists the copies of the slots at once, which could not be
+ * rolled back, so it ends the epoch before the new segments are published. */
+template<typename KV>
+struct buffered_epochs {
+    /* Types */
+    struct alignas(64) undo_entry {
+        /* The offset of the slot in the segment pool */
+        size_t slot;
+        size_t old_data;
+        size_t new_data;
+        size_t epoch;
+        /* Orders the writes of a slot by different threads */
+        size_t tsc;
+    };
+
+    /* The entries of the two open epochs, by parity */
+    struct undo_log {
+        undo_entry entries[2][EPOCH_LOG_SIZE];
+    };
+
+    struct alignas(64) writer {
+        size_t id;
+        /* The epoch the writer is in, or IDLE */
+        std::atomic<size_t> active{IDLE};
+        size_t epoch_of[2]{};
+        size_t tail[2]{};
+        std::vector<kv_ptr<KV> *> dirty[2];
+    };
+
+    inline static constexpr size_t IDLE = ~0ul;
+
+    /* Data members */
+    inline static bool buffered = false;
+    inline static epoch_root *root = nullptr;
+    inline static undo_log *logs = nullptr;
+    inline static std::atomic<size_t> global_epoch{1};
+    inline static std::array<writer, EPOCH_THREAD_NUM> writers;
+    inline static std::atomic<size_t> writer_num{0};
+    inline static thread_local writer *self = nullptr;
+    inline static std::mutex mtx;
+    inline static std::thread ticker;
+    inline static std::atomic<bool> stop{false};
+
+    /* Interfaces */
+    /* Roll back the epochs a crash left open, then run with epochs of
+     * interval_us, or persist every write if it is 0 */
+    static void open(PMEMobjpool *pop, epoch_root *in_root,
+                     size_t interval_us) {
+        root = in_root;
+        if (root->interval_us && !OID_IS_NULL(root->logs)) {
+            logs = reinterpret_cast<undo_log *>(pmemobj_direct(root->logs));
+            rollback();
+        }
+        if (interval_us && OID_IS_NULL(root->logs) &&
+            pmemobj_zalloc(pop, &root->logs,
+                           EPOCH_THREAD_NUM * sizeof(undo_log), 0)) {
+            throw std::runtime_error("cannot allocate the undo logs");
+        }
+        root->interval_us = interval_us;
+        persist(&root->interval_us, sizeof(root->interval_us),
+                flush_kind::METADATA);
+        if (interval_us == 0) { return; }
+
+        logs = reinterpret_cast<undo_log *>(pmemobj_direct(root->logs));
+        global_epoch = root->durable_epoch + 1;
+        for (auto &w : writers) {
+            w.epoch_of[0] = w.epoch_of[1] = 0;
+            w.dirty[0].clear();
+            w.dirty[1].clear();
+        }
+        buffered = true;
+        stop = false;
+        ticker = std::thread([interval_us] {
+            while (!stop) {
+                std::this_thread::sleep_for(
+                        std::chrono::microseconds(interval_us));
+                sync();
+            }
+        });
+        fmt::print("buffered durability: {} us epochs from epoch {}\n",
+                   interval_us, global_epoch.load());
+    }
+
+    /* Persist the open epoch and stop the epoch thread */
+    static void close() {
+        if (!buffered) { return; }
+        stop = true;
+        ticker.join();
+        sync();
+        buffered = false;
+    }
+
+    /* CAS a slot without a flush, its old value is logged for a rollback */
+    static bool write(kv_ptr<KV> &slot, size_t expected, size_t desired) {
+        auto &w = self ? *self : enroll();
+        size_t e;
+        while (true) {
+            e = global_epoch.load(std::memory_order_acquire);
+            auto h = e & 1;
+            if (w.epoch_of[h] != e) {
+                /* The epoch of the same parity before is durable */
+                w.epoch_of[h] = e;
+                w.tail[h] = 0;
+            }
+            if (w.tail[h] == EPOCH_LOG_SIZE) {
+                /* The log is full, end the epoch now */
+                sync();
+                continue;
+            }
+            w.active.store(e);
+            if (global_epoch.load() == e) { break; }
+            w.active.store(IDLE, std::memory_order_release);
+        }
+        auto h = e & 1;
+        stream(logs[w.id].entries[h][w.tail[h]++],
+               undo_entry{(size_t) ((char *) &slot -
+                                    (char *) segment_ptr<KV>::base),
+                          expected, desired, e, __rdtsc()});
+        /* The entry is on PM before the slot can be evicted */
+        _mm_sfence();
+        add_write_counter<KV>(sizeof(undo_entry));
+
+        bool ret = slot.cas(expected, desired);
+        if (ret && (w.dirty[h].empty() ||
+                    line_of(w.dirty[h].back()) != line_of(&slot))) {
+            w.dirty[h].push_back(&slot);
+        }
+        w.active.store(IDLE, std::memory_order_release);
+        return ret;
+    }
+
+    /* End the current epoch and wait until its writes are persistent */
+    static void sync() {
+        if (!buffered) { return; }
+        std::lock_guard<std::mutex> lg(mtx);
+        auto e = global_epoch.load();
+        global_epoch.store(e + 1);
+        auto n = std::min(writer_num.load(), EPOCH_THREAD_NUM);
+        for (size_t i = 0; i < n; i++) {
+            while (writers[i].active.load() == e) { _mm_pause(); }
+        }
+        for (size_t i = 0; i < n; i++) {
+            auto &dirty = writers[i].dirty[e & 1];
+            for (auto slot : dirty) {
+                flush(slot, sizeof(kv_ptr<KV>), flush_kind::SLOT);
+            }
+            add_write_counter<KV>(dirty.size() * sizeof(kv_ptr<KV>));
+            dirty.clear();
+        }
+        drain();
+        root->durable_epoch = e;
+        persist(&root->durable_epoch, sizeof(root->durable_epoch),
+                flush_kind::LOG);
+    }
+
+    /* Helper functions */
+    static writer &enroll() {
+        auto id = writer_num.fetch_add(1);
+        if (id >= EPOCH_THREAD_NUM) {
+            throw std::runtime_error("too many writers for the undo logs");
+        }
+        writers[id].id = id;
+        self = &writers[id];
+        return *self;
+    }
+
+    static size_t line_of(void const *addr) { return (size_t) addr >> 6; }
+
+    static void stream(undo_entry &dst, undo_entry const &src) {
+        auto d = reinterpret_cast<long long *>(&dst);
+        auto s = reinterpret_cast<long long const *>(&src);
+        for (size_t i = 0; i < sizeof(undo_entry) / sizeof(long long); i++) {
+            _mm_stream_si64(d + i, s[i]);
+        }
+        pmhb_ns::trace_flush(&dst, sizeof(undo_entry), flush_kind::LOG);
+    }
+
+    /* Undo the writes of the epochs after the durable one, the latest
+     * first. A write is only undone if the slot still holds it, so that the
+     * entry of a failed CAS is skipped */
+    static void rollback() {
+        time_guard tg("Roll back the open epochs");
+        auto durable = root->durable_epoch;
+        auto last = durable;
+        std::vector<undo_entry const *> undo;
+        for (size_t i = 0; i < EPOCH_THREAD_NUM; i++) {
+            for (auto const &half : logs[i].entries) {
+                for (auto const &entry : half) {
+                    if (entry.epoch <= durable) { continue; }
+                    undo.push_back(&entry);
+                    last = std::max(last, entry.epoch);
+                }
+            }
+        }
+        std::sort(undo.begin(), undo.end(),
+                  [](auto a, auto b) { return a->tsc > b->tsc; });
+
+        constexpr size_t flags = kv_ptr<KV>::COPIED_FLAG_MASK |
+                                 kv_ptr<KV>::VOLATILE_FLAG_MASK;
+        size_t n = 0;
+        for (auto entry : undo) {
+            auto slot = reinterpret_cast<kv_ptr<KV> *>(
+                    (char *) segment_ptr<KV>::base + entry->slot);
+            if ((slot->data & ~flags) != (entry->new_data & ~flags)) {
+                continue;
+            }
+            slot->data = entry->old_data & ~flags;
+            persist(slot, sizeof(kv_ptr<KV>), flush_kind::SLOT);
+            n++;
+        }
+        /* The entries are done with */
+        root->durable_epoch = last;
+        persist(&root->durable_epoch, sizeof(root->durable_epoch),
+                flush_kind::LOG);
+        fmt::print("rolled back {} writes after epoch {}\n", n, durable);
+    }
+};
+
+}// namespace steph_ns
+
+#endif//STEPH_EPOCH_HPP
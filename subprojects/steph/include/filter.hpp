@@ -0,0 +1,106 @@
+#ifndef STEPH_FILTER_HPP
+#define STEPH_FILTER_HPP
+
+#include "config.hpp"
+
+#include <array>
+#include <cstdint>
+#include <fmt/core.h>
+#include <stdexcept>
+#include <sys/mman.h>
+
+namespace steph_ns {
+
+/* A DRAM membership filter of one bucket, to skip PM probes of absent keys */
+struct bucket_filter {
+    /* Data members */
+    std::array<uint64_t, FILTER_BIT_NUM_PER_BUCKET / 64> words;
+
+    /* Interfaces */
+    void add(size_t hash) {
+        for (size_t i = 0; i < FILTER_PROBE_NUM; i++) {
+            auto bit = probe(hash, i);
+            __atomic_fetch_or(&words[bit >> 6], 1ul << (bit & 63),
+                              __ATOMIC_RELEASE);
+        }
+    }
+
+    bool may_contain(size_t hash) const {
+        for (size_t i = 0; i < FILTER_PROBE_NUM; i++) {
+            auto bit = probe(hash, i);
+            if (!(__atomic_load_n(&words[bit >> 6], __ATOMIC_ACQUIRE) &
+                  (1ul << (bit & 63)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Keys only move between buckets in splits, so the bits of the source
+     * bucket are a superset of every bucket it is shunted to */
+    void inherit(bucket_filter const &src) {
+        for (size_t i = 0; i < words.size(); i++) {
+            __atomic_store_n(&words[i],
+                             __atomic_load_n(&src.words[i], __ATOMIC_ACQUIRE),
+                             __ATOMIC_RELEASE);
+        }
+    }
+
+    void clear() {
+        for (auto &w : words) { __atomic_store_n(&w, 0, __ATOMIC_RELEASE); }
+    }
+
+private:
+    /* Helper functions */
+    inline static size_t probe(size_t hash, size_t i) {
+        /* Remix the hash, since the high bits are shared by the whole bucket
+         * and the middle bits are used as fingerprints */
+        size_t mixed = hash * 0x9e37'79b9'7f4a'7c15ul;
+        return (mixed >> (64 - (i + 1) * FILTER_PROBE_BIT_NUM)) &
+               (FILTER_BIT_NUM_PER_BUCKET - 1);
+    }
+};
+
+
+/* Filters of a physical segment, indexed by the offset of the segment */
+template<typename KV>
+struct segment_filter {
+    /* Data members */
+    std::array<bucket_filter, BUCKET_NUM_PER_SEGMENT> buckets;
+    inline static segment_filter *base = nullptr;
+    inline static size_t capacity = 0;
+
+    /* Interfaces */
+    /* Reserve filters for every segment of the pool, pages are only backed
+     * when the segments are used */
+    static void map(size_t segment_num) {
+        unmap();
+        auto addr = mmap(nullptr, segment_num * sizeof(segment_filter),
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("cannot map the segment filters");
+        }
+        base = reinterpret_cast<segment_filter *>(addr);
+        capacity = segment_num;
+        fmt::print("segment filters mapped for {} segments\n", segment_num);
+    }
+
+    static void unmap() {
+        if (base) { munmap(base, capacity * sizeof(segment_filter)); }
+        base = nullptr;
+        capacity = 0;
+    }
+
+    static segment_filter &of(size_t segment_offset) {
+        return base[segment_offset];
+    }
+
+    void clear() {
+        for (auto &b : buckets) { b.clear(); }
+    }
+};
+
+}// namespace steph_ns
+
+#endif//STEPH_FILTER_HPP
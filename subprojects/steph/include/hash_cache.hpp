@@ -0,0 +1,103 @@
+#ifndef STEPH_HASH_CACHE_HPP
+#define STEPH_HASH_CACHE_HPP
+
+#include "config.hpp"
+
+#include <array>
+#include <cstdint>
+#include <fmt/core.h>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+
+namespace steph_ns {
+
+template<typename KV>
+struct kv_ptr;
+template<typename KV>
+struct segment_ptr;
+template<typename KV>
+struct Segment;
+
+/* The full hashes of the keys in a physical segment, slot by slot, indexed
+ * by the offset of the segment (CACHE_HASH). Splits and fingerprint
+ * refreshes read them instead of dereferencing the KVs on PM. A hash of 0
+ * is unknown and computed from the key. They live in DRAM only and are
+ * rebuilt at recovery, so an insert does not pay an extra persist. */
+template<typename KV>
+struct segment_hashes {
+    /* Data members */
+    std::array<std::array<uint64_t, KV_NUM_PER_BUCKET>, BUCKET_NUM_PER_SEGMENT>
+            buckets;
+    inline static segment_hashes *base = nullptr;
+    inline static size_t capacity = 0;
+
+    /* Interfaces */
+    /* Reserve hashes for every segment of the pool, pages are only backed
+     * when the segments are used */
+    static void map(size_t segment_num) {
+        unmap();
+        auto addr = mmap(nullptr, segment_num * sizeof(segment_hashes),
+                         PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("cannot map the segment hashes");
+        }
+        base = reinterpret_cast<segment_hashes *>(addr);
+        capacity = segment_num;
+        fmt::print("segment hashes mapped for {} segments\n", segment_num);
+    }
+
+    static void unmap() {
+        if (base) { munmap(base, capacity * sizeof(segment_hashes)); }
+        base = nullptr;
+        capacity = 0;
+    }
+
+    static segment_hashes &of(size_t segment_offset) {
+        return base[segment_offset];
+    }
+
+    /* The entry of a slot in the segment pool */
+    static uint64_t &at(kv_ptr<KV> const *slot) {
+        constexpr size_t bucket_size =
+                sizeof(Segment<KV>) / BUCKET_NUM_PER_SEGMENT;
+        size_t pos = (char const *) slot -
+                     (char const *) segment_ptr<KV>::base;
+        auto &hashes = base[pos / sizeof(Segment<KV>)];
+        pos %= sizeof(Segment<KV>);
+        return hashes.buckets[pos / bucket_size]
+                             [pos % bucket_size / sizeof(kv_ptr<KV>)];
+    }
+};
+
+
+/* The hash of the key a slot in the segment pool points to, value being a
+ * snapshot of the slot */
+template<typename KV>
+inline size_t hash_of_slot(kv_ptr<KV> const &slot, kv_ptr<KV> const &value) {
+#ifdef CACHE_HASH
+    if (auto hash = __atomic_load_n(&segment_hashes<KV>::at(&slot),
+                                    __ATOMIC_ACQUIRE)) {
+        return hash;
+    }
+#endif
+    return std::hash<std::string_view>{}(value->key());
+}
+
+template<typename KV>
+inline size_t hash_of_slot(kv_ptr<KV> const &slot) {
+    return hash_of_slot(slot, slot);
+}
+
+/* Remember the hash of the key just written to a slot */
+template<typename KV>
+inline void cache_hash(kv_ptr<KV> &slot, size_t hash) {
+#ifdef CACHE_HASH
+    __atomic_store_n(&segment_hashes<KV>::at(&slot), hash, __ATOMIC_RELEASE);
+#endif
+}
+
+}// namespace steph_ns
+
+#endif//STEPH_HASH_CACHE_HPP
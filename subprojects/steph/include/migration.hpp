@@ -0,0 +1,149 @@
+#ifndef STEPH_MIGRATION_HPP
+#define STEPH_MIGRATION_HPP
+
+#include "config.hpp"
+#include "steph.hpp"
+#include "util.hpp"
+
+#include <atomic>
+#include <immintrin.h>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+namespace steph_ns {
+
+/* A live migration of a table to another one, e.g. in another pool. The
+ * keys are split into 2^MIGRATION_RANGE_BITS ranges by hash prefix, which a
+ * background mover copies one by one. Operations on a range go to the
+ * source before it is copied and to the target after. Reads never wait,
+ * writes only wait while their own range is being copied.
+ *
+ * The tables of one KV type share their pools, so the target uses its own
+ * KV type of the same layout, e.g. "struct target_kv : varlen_kv {}". The
+ * KV records are shared by offset unless the target stores them itself
+ * (WRITE_KV or VALUE_HEAP), so only the index is held twice. */
+template<typename SrcKV, typename DstKV>
+struct migration {
+    static_assert(std::is_base_of_v<SrcKV, DstKV> &&
+                          sizeof(SrcKV) == sizeof(DstKV),
+                  "the target KV must be a layout-compatible subclass");
+
+    /* Types */
+    /* The gate of a range counts the writers in the source, or is one of */
+    enum gate_state : int64_t { COPYING = -1, MIGRATED = -2 };
+
+    /* Data members */
+    steph<SrcKV> *src;
+    steph<DstKV> *dst;
+    std::unique_ptr<std::atomic<int64_t>[]> gates;
+    std::atomic<size_t> migrated_num{0};
+    std::atomic<size_t> copied_kv_num{0};
+    std::thread mover;
+
+    /* Constructors */
+    migration(steph<SrcKV> *in_src, steph<DstKV> *in_dst)
+        : src(in_src), dst(in_dst),
+          gates(std::make_unique<std::atomic<int64_t>[]>(range_num())) {
+        for (size_t r = 0; r < range_num(); r++) { gates[r] = 0; }
+    }
+
+    ~migration() {
+        if (mover.joinable()) { mover.join(); }
+    }
+
+    /* Interfaces */
+    void start() { mover = std::thread([this] { move(); }); }
+
+    /* Wait for all ranges to be copied, then the source is no longer used
+     * and can be closed */
+    steph<DstKV> *finish() {
+        if (mover.joinable()) { mover.join(); }
+        print("migration finished, {} KVs copied\n", copied_kv_num.load());
+        return dst;
+    }
+
+    double progress() const {
+        return (double) migrated_num.load() / range_num();
+    }
+
+    SrcKV *search(std::string_view k) {
+        if (gates[range_of(k)].load(std::memory_order_acquire) == MIGRATED) {
+            return dst->search(k);
+        }
+        /* The source is complete until the range is migrated */
+        return src->search(k);
+    }
+
+    bool insert(std::string_view k, std::string_view v, size_t kv_offset = 0,
+                bool is_load = false) {
+        return write(
+                k,
+                [&] { return src->insert(k, v, kv_offset, is_load); },
+                [&] { return dst->insert(k, v, kv_offset, is_load); });
+    }
+
+    bool update(std::string_view k, std::string_view v, size_t kv_offset) {
+        return write(
+                k, [&] { return src->update(k, v, kv_offset); },
+                [&] { return dst->update(k, v, kv_offset); });
+    }
+
+    bool Delete(std::string_view k) {
+        return write(
+                k, [&] { return src->Delete(k); },
+                [&] { return dst->Delete(k); });
+    }
+
+    /* Helper functions */
+    static constexpr size_t range_num() { return 1ul << MIGRATION_RANGE_BITS; }
+
+    static size_t range_of(std::string_view k) {
+        return std::hash<std::string_view>{}(k) >> (64 - MIGRATION_RANGE_BITS);
+    }
+
+    template<typename S, typename D>
+    bool write(std::string_view k, S &&on_src, D &&on_dst) {
+        auto &gate = gates[range_of(k)];
+        while (true) {
+            auto g = gate.load(std::memory_order_acquire);
+            if (g == MIGRATED) { return on_dst(); }
+            if (g >= 0 && gate.compare_exchange_weak(g, g + 1)) {
+                auto ret = on_src();
+                gate.fetch_sub(1, std::memory_order_release);
+                return ret;
+            }
+            _mm_pause();
+        }
+    }
+
+    /* The background mover */
+    void move() {
+        time_guard tg("Migrate the table");
+        for (size_t r = 0; r < range_num(); r++) {
+            /* Close the range to the writers and wait for the running ones */
+            auto &gate = gates[r];
+            for (int64_t idle = 0;
+                 !gate.compare_exchange_weak(idle, COPYING); idle = 0) {
+                _mm_pause();
+            }
+            size_t n = 0;
+            src->for_each_in_range(
+                    r, MIGRATION_RANGE_BITS, [&](SrcKV *kv, size_t offset) {
+                        /* A KV passed twice is skipped by the uniqueness
+                         * check of the target */
+                        dst->insert(kv->key(), kv->value(),
+                                    kv_ptr<DstKV>{offset, 0, 0, 0});
+                        n++;
+                    });
+            copied_kv_num.fetch_add(n, std::memory_order_relaxed);
+            gate.store(MIGRATED, std::memory_order_release);
+            migrated_num.fetch_add(1, std::memory_order_release);
+        }
+    }
+};
+
+}// namespace steph_ns
+
+#endif//STEPH_MIGRATION_HPP
@@ -0,0 +1,76 @@
+#ifndef STEPH_PERSIST_HPP
+#define STEPH_PERSIST_HPP
+
+#include <cstring>
+#include <fmt/core.h>
+#include <immintrin.h>
+#include <libpmem.h>
+
+#include "../../include/flush_trace.hpp"
+
+namespace steph_ns {
+
+using pmhb_ns::flush_kind;
+
+/* Where the stores become persistent, chosen at runtime. In the ADR domain
+ * a range is flushed from the CPU caches. In the eADR domain the caches
+ * are persistent, so a store fence is enough to order the stores and no
+ * slot is written with the dirty flag. */
+struct persistence_domain {
+    /* Data members */
+    inline static bool eadr = false;
+
+    /* Interfaces */
+    static void set_eadr(bool in_eadr) {
+        eadr = in_eadr;
+        fmt::print("persistence domain: {}\n", eadr ? "eADR" : "ADR");
+    }
+
+    /* Whether the platform flushes the CPU caches on power failure */
+    static bool detect_eadr() { return pmem_has_auto_flush() == 1; }
+};
+
+inline void persist(const void *addr, size_t len,
+                    flush_kind kind = flush_kind::OTHER) {
+    pmhb_ns::trace_flush(addr, len, kind);
+    if (persistence_domain::eadr) {
+        _mm_sfence();
+    } else {
+        pmem_persist(addr, len);
+    }
+}
+
+/* Flush without waiting, a drain() makes the flushed ranges persistent */
+inline void flush(const void *addr, size_t len,
+                  flush_kind kind = flush_kind::OTHER) {
+    pmhb_ns::trace_flush(addr, len, kind);
+    if (!persistence_domain::eadr) { pmem_flush(addr, len); }
+}
+
+inline void drain() { _mm_sfence(); }
+
+inline void *memcpy_persist(void *dst, const void *src, size_t len,
+                            flush_kind kind = flush_kind::OTHER) {
+    pmhb_ns::trace_flush(dst, len, kind);
+    if (persistence_domain::eadr) {
+        memcpy(dst, src, len);
+        _mm_sfence();
+        return dst;
+    }
+    return pmem_memcpy_persist(dst, src, len);
+}
+
+inline void *memset_persist(void *dst, int c, size_t len,
+                            flush_kind kind = flush_kind::OTHER) {
+    pmhb_ns::trace_flush(dst, len, kind);
+    if (persistence_domain::eadr) {
+        memset(dst, c, len);
+        _mm_sfence();
+        return dst;
+    }
+    return pmem_memset_persist(dst, c, len);
+}
+
+}// namespace steph_ns
+
+#endif//STEPH_PERSIST_HPP
@@ -0,0 +1,224 @@
+#ifndef STEPH_SHARDED_HPP
+#define STEPH_SHARDED_HPP
+
+#include "config.hpp"
+#include "steph.hpp"
+#include "util.hpp"
+
+#include <array>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace steph_ns {
+
+/* The KV type of the shard I. The pools, the segment base and the DRAM
+ * caches of a table are statics of its KV type, so each shard gets a KV type
+ * of its own with the same layout, as the target of a migration does. */
+template<typename KV, size_t I>
+struct shard_kv : KV {
+    using KV::KV;
+};
+
+/* The NUMA node of the device that holds path, -1 if it is unknown */
+inline int numa_node_of(std::filesystem::path const &path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st)) { return -1; }
+    auto dev = fmt::format("/sys/dev/block/{}:{}", major(st.st_dev),
+                           minor(st.st_dev));
+    /* A partition has no device link of its own, its disk does */
+    for (auto sys : {dev + "/device/numa_node", dev + "/../device/numa_node"}) {
+        std::ifstream f(sys);
+        int node = -1;
+        if (f >> node) { return node; }
+    }
+    return -1;
+}
+
+/* The CPUs of a NUMA node, read from its cpulist, e.g. "0-23,48-71" */
+inline cpu_set_t cpus_of_node(int node) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::ifstream f(fmt::format("/sys/devices/system/node/node{}/cpulist",
+                                node));
+    std::string range;
+    while (std::getline(f, range, ',')) {
+        auto dash = range.find('-');
+        auto lo = std::stoul(range.substr(0, dash));
+        auto hi = dash == std::string::npos ? lo
+                                            : std::stoul(range.substr(dash + 1));
+        for (auto cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return set;
+}
+
+/* Run the calling thread on the CPUs of a node until the guard is gone. The
+ * threads it starts meanwhile, e.g. the hidden worker of a table, keep the
+ * node, and the pages it faults in are allocated there */
+struct node_guard {
+    cpu_set_t saved;
+    bool bound = false;
+
+    explicit node_guard(int node) {
+        if (node < 0) { return; }
+        auto set = cpus_of_node(node);
+        if (CPU_COUNT(&set) == 0) { return; }
+        sched_getaffinity(0, sizeof(saved), &saved);
+        bound = sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+
+    ~node_guard() {
+        if (bound) { sched_setaffinity(0, sizeof(saved), &saved); }
+    }
+};
+
+/* A table sharded over PM namespaces, usually one per NUMA node. Each shard
+ * is a complete table in its own pool, opened on the CPUs of the node of
+ * its pool, and a key goes to the shard of its hash. A thread can ask for
+ * the node of the shard of a key and run its commands there. */
+template<typename KV, size_t SHARD_NUM = MAX_SHARD_NUM>
+struct sharded_steph {
+    /* Types */
+    template<size_t I>
+    using shard_type = steph<shard_kv<KV, I>>;
+
+    static_assert(sizeof(shard_kv<KV, 0>) == sizeof(KV),
+                  "a shard KV must be layout-compatible with the KV");
+
+    template<typename Seq>
+    struct shard_tuple;
+
+    template<size_t... I>
+    struct shard_tuple<std::index_sequence<I...>> {
+        using type = std::tuple<shard_type<I> *...>;
+    };
+
+    /* Data members */
+    size_t shard_num = 0;
+    typename shard_tuple<std::make_index_sequence<SHARD_NUM>>::type shards{};
+    std::array<int, SHARD_NUM> nodes{};
+
+    /* Interfaces */
+    /* Create or open a shard in each pool path, the pool size and the
+     * expected keys are for the whole table */
+    static sharded_steph *open(std::vector<std::filesystem::path> const &paths,
+                               size_t pool_size = DEFAULT_POOL_SIZE,
+                               size_t init_depth = 8, size_t kv_uulo = 0,
+                               size_t expected_keys = 0,
+                               size_t epoch_us = 0) {
+        if (paths.empty() || paths.size() > SHARD_NUM) {
+            throw std::runtime_error(
+                    fmt::format("a sharded table takes 1 to {} pools, not {}",
+                                SHARD_NUM, paths.size()));
+        }
+        auto ret = new sharded_steph;
+        ret->shard_num = paths.size();
+        ret->for_each_index([&](auto I) {
+            auto &path = paths[I];
+            ret->nodes[I] = numa_node_of(path.parent_path());
+            print("shard {} in {} on node {}\n", (size_t) I, path.c_str(),
+                  ret->nodes[I]);
+            node_guard ng(ret->nodes[I]);
+            std::get<I>(ret->shards) = shard_type<I>::open(
+                    path, pool_size / ret->shard_num, init_depth, kv_uulo,
+                    expected_keys / ret->shard_num, epoch_us);
+        });
+        return ret;
+    }
+
+    static void close(sharded_steph *map) {
+        map->for_each_index([&](auto I) {
+            shard_type<I>::close(std::get<I>(map->shards));
+        });
+        delete map;
+    }
+
+    void recover() {
+        for_each_index([&](auto I) {
+            node_guard ng(nodes[I]);
+            std::get<I>(shards)->recover();
+        });
+    }
+
+    KV *search(std::string_view k) {
+        return with_shard(shard_of(k),
+                          [&](auto shard) -> KV * { return shard->search(k); });
+    }
+
+    bool insert(std::string_view k, std::string_view v, kv_ptr<KV> pkv = {},
+                bool is_load = false) {
+        return with_shard(shard_of(k), [&](auto shard) {
+            return shard->insert(k, v, pkv.data, is_load);
+        });
+    }
+
+    bool update(std::string_view k, std::string_view v, kv_ptr<KV> pkv) {
+        return with_shard(shard_of(k), [&](auto shard) {
+            return shard->update(k, v, pkv.data);
+        });
+    }
+
+    bool Delete(std::string_view k) {
+        return with_shard(shard_of(k),
+                          [&](auto shard) { return shard->Delete(k); });
+    }
+
+    size_t get_memory_usage() {
+        size_t ret = 0;
+        for_each_index([&](auto I) {
+            ret += std::get<I>(shards)->get_memory_usage();
+        });
+        return ret;
+    }
+
+    /* The shards share the event counters */
+    static stats_snapshot stats() { return shard_type<0>::stats(); }
+
+    /* The shard of a key. The tables index their directories with the top
+     * bits of the hash and, with TRADITIONAL_SPLIT, take the fingerprints
+     * from the low 16, so the shard is chosen by the 16 bits above those */
+    size_t shard_of(std::string_view k) const {
+        auto hash = std::hash<std::string_view>{}(k);
+        return (((hash >> 16) & 0xfffful) * shard_num) >> 16;
+    }
+
+    /* The NUMA node of a shard, -1 if it is unknown */
+    int node_of(size_t shard) const { return nodes[shard]; }
+
+    /* Helper functions */
+    /* Call fn with std::integral_constant<size_t, I> for the open shards */
+    template<typename F>
+    void for_each_index(F &&fn) {
+        [&]<size_t... I>(std::index_sequence<I...>) {
+            ((I < shard_num ? fn(std::integral_constant<size_t, I>{})
+                            : void()),
+             ...);
+        }(std::make_index_sequence<SHARD_NUM>{});
+    }
+
+    template<size_t I = 0, typename F>
+    decltype(auto) with_shard(size_t shard, F &&fn) {
+        if constexpr (I + 1 < SHARD_NUM) {
+            if (shard != I) {
+                return with_shard<I + 1>(shard, std::forward<F>(fn));
+            }
+        }
+        return fn(std::get<I>(shards));
+    }
+};
+
+}// namespace steph_ns
+
+#endif//STEPH_SHARDED_HPP
@@ -0,0 +1,103 @@
+#ifndef STEPH_STATS_HPP
+#define STEPH_STATS_HPP
+
+#include <array>
+#include <cstddef>
+#include <fmt/core.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace steph_ns {
+
+/* Internal events counted in every build */
+enum stat_event : size_t {
+    INSERT_RETRY,   // an insert restarts from the directory
+    SPLIT_LOCK_FAIL,// a full segment is being split by another thread
+    COPIED_RETRY,   // an operation meets a slot copied by a split
+    DOUBLING_WAIT,  // an insert waits for the directory doubling
+    HELPER_FLUSH,   // a reader persists a slot with the dirty flag
+    SEGMENT_ALLOC,  // a physical segment is allocated
+    RECORD_RELOCATE,// the value heap cleaner moves a live record
+    CHUNK_RECLAIM,  // the value heap cleaner empties a chunk
+    STAT_EVENT_NUM
+};
+
+inline constexpr std::array<const char *, STAT_EVENT_NUM> STAT_EVENT_NAMES{
+        "insert_retry",  "split_lock_fail", "copied_retry",
+        "doubling_wait", "helper_flush",    "segment_alloc",
+        "record_relocate", "chunk_reclaim"};
+
+
+/* An aggregation of the counters of all threads */
+struct stats_snapshot {
+    /* Data members */
+    std::array<size_t, STAT_EVENT_NUM> counts{};
+    size_t refresh_queue_depth = 0;
+    size_t refresh_queue_peak = 0;
+
+    /* Operators */
+    size_t operator[](stat_event e) const { return counts[e]; }
+
+    std::string information() const {
+        std::string ret;
+        for (size_t i = 0; i < STAT_EVENT_NUM; i++) {
+            ret += fmt::format("{} {}, ", STAT_EVENT_NAMES[i], counts[i]);
+        }
+        ret += fmt::format("refresh_queue_depth {} (peak {})",
+                           refresh_queue_depth, refresh_queue_peak);
+        return ret;
+    }
+};
+
+
+/* Per-thread counters, written only by the owner without atomic RMW and
+ * summed up by stat_counters::snapshot() */
+struct stat_counters {
+    /* Types */
+    struct block {
+        std::array<size_t, STAT_EVENT_NUM> counts{};
+
+        block() {
+            auto g = std::lock_guard{mtx};
+            live.push_back(this);
+        }
+        ~block() {
+            /* Keep the counts of exited threads */
+            auto g = std::lock_guard{mtx};
+            for (size_t i = 0; i < STAT_EVENT_NUM; i++) {
+                retired[i] += counts[i];
+            }
+            std::erase(live, this);
+        }
+    };
+
+    /* Data members */
+    inline static std::mutex mtx;
+    inline static std::vector<block *> live;
+    inline static std::array<size_t, STAT_EVENT_NUM> retired{};
+    inline static thread_local block local;
+
+    /* Interfaces */
+    static void count(stat_event e, size_t n = 1) {
+        auto &c = local.counts[e];
+        __atomic_store_n(&c, c + n, __ATOMIC_RELAXED);
+    }
+
+    static stats_snapshot snapshot() {
+        stats_snapshot ret;
+        auto g = std::lock_guard{mtx};
+        ret.counts = retired;
+        for (auto b : live) {
+            for (size_t i = 0; i < STAT_EVENT_NUM; i++) {
+                ret.counts[i] +=
+                        __atomic_load_n(&b->counts[i], __ATOMIC_RELAXED);
+            }
+        }
+        return ret;
+    }
+};
+
+}// namespace steph_ns
+
+#endif//STEPH_STATS_HPP
@@ -42,13 +42,25 @@
 
 #include "alloc.hpp"
 #include "config.hpp"
+#include "coro.hpp"
+#include "filter.hpp"
 #include "substructure.hpp"
+#ifdef VALUE_HEAP
+#include "value_heap.hpp"
+#elif defined INPLACE_UPDATE
+#error "INPLACE_UPDATE overwrites the records of the VALUE_HEAP"
+#endif
 
+#include <fcntl.h>
 #include <filesystem>
 #include <libpmem.h>
 #include <libpmemobj.h>
+#include <memory>
+#include <optional>
 #include <set>
 #include <string_view>
+#include <sys/mman.h>
+#include <unistd.h>
 #if defined PMHB_LATENCY || defined COUNTING_WRITE
 #include "../../include/sample_guard.hpp"
 #endif
@@ -60,7 +72,18 @@ template<typename KV>
 struct steph {
     /* Data members */
     c_ptr<Directory<KV>> dir;
+#ifdef VALUE_HEAP
+    /* The chunk table of the value heap */
+    PMEMoid heap_chunks;
+    size_t heap_chunk_capacity;
+#endif
+    /* The buffered durability of the slots */
+    epoch_root epochs;
+    /* The redo logs of the batches */
+    PMEMoid batch_logs;
     inline static pmem::obj::pool<steph<KV>> pm_pool;
+    /* The pools mapped by a read-only open */
+    inline static std::vector<std::pair<char *, size_t>> readonly_pools;
 
 #ifndef SINGLE_THREAD
     inline static BG_worker<KV> hidden_worker;
@@ -72,10 +95,21 @@ struct steph {
     steph() = delete;
 
     /* Interfaces */
-    /* Create or open a stable hash table */
+    /* Create or open a stable hash table, a new table is sized for
+     * expected_keys if given. With epoch_us, a write is persistent at the
+     * end of its epoch of epoch_us instead of when it returns, and opening
+     * the table after a crash rolls back the epochs that were left open */
     static steph *open(std::filesystem::path pool_path,
                        size_t pool_size = DEFAULT_POOL_SIZE,
-                       size_t init_depth = 8, size_t kv_uulo = 0) {
+                       size_t init_depth = 8, size_t kv_uulo = 0,
+                       size_t expected_keys = 0, size_t epoch_us = 0) {
+#ifdef VALUE_HEAP
+        if (epoch_us) {
+            /* The records replaced in an open epoch are released at once */
+            throw std::runtime_error(
+                    "buffered durability does not support the value heap");
+        }
+#endif
         steph *ret = nullptr;
         fmt::print("pool size is {}\n", pool_size);
         pool_size /= 2;// for the main pool and the segment pool.
@@ -88,12 +122,32 @@ struct steph {
             seg_path += ".seg";
             print("seg path is {}\n", seg_path.c_str());
             Segment<KV>::allocator = stack_allocator<Segment<KV>>::open(
-                    seg_path.c_str(), pool_size);
+                    seg_path.c_str(), pool_size, true);
+            segment_ptr<KV>::base = (Segment<KV> *) Segment<KV>::allocator;
+#ifdef BLOOM_FILTER
+            segment_filter<KV>::map(Segment<KV>::allocator->length /
+                                    sizeof(Segment<KV>));
+#endif
+#ifdef CACHE_HASH
+            segment_hashes<KV>::map(Segment<KV>::allocator->length /
+                                    sizeof(Segment<KV>));
+#endif
+            auto uulo = pm_pool.root().raw().pool_uuid_lo;
+            c_ptr<Directory<KV>>::pool_uuid_lo = uulo;
+            c_ptr<Segment<KV>>::pool_uuid_lo = uulo;
+            c_ptr<segment_ptr<KV>>::pool_uuid_lo = uulo;
             if (kv_uulo) {
                 kv_ptr<KV>::pool_uuid_lo = kv_uulo;
             } else {
-                kv_ptr<KV>::pool_uuid_lo = pm_pool.root().raw().pool_uuid_lo;
+                kv_ptr<KV>::pool_uuid_lo = uulo;
             }
+#ifdef VALUE_HEAP
+            kv_ptr<KV>::pool_uuid_lo = uulo;
+            ret->open_value_heap();
+#endif
+#ifndef SINGLE_THREAD
+            hidden_worker.initialize(ret);
+#endif
         } else {
             fmt::print("open: To create the pool\n");
             pm_pool = pmem::obj::pool<steph<KV>>::create(
@@ -104,20 +158,117 @@ struct steph {
                 pre_fault(pm_pool.handle(), pool_size);
             }
             ret = pm_pool.root().get();
+            if (expected_keys) {
+                init_depth = std::max(
+                        init_depth,
+                        depth_for(expected_keys,
+                                  pool_size / sizeof(Segment<KV>)));
+            }
             ret->initialize(pool_path, init_depth, pool_size, kv_uulo);
         }
+        Segment<KV>::allocator->root_offset = pm_pool.root().raw().off;
+        persist(&Segment<KV>::allocator->root_offset, sizeof(size_t),
+                flush_kind::METADATA);
+        buffered_epochs<KV>::open(pm_pool.handle(), &ret->epochs, epoch_us);
+        ret->open_batch_logs();
+        return ret;
+    }
+
+    /* Open a table for searches only, e.g. a frozen copy of the pools that
+     * analytics processes share. The pools are mapped read-only without
+     * libpmemobj, the searches leave the dirty slots to the writer and no
+     * background worker runs, so nothing is written. kv_path is the pool of
+     * the KVs if they are not kept in the table pool. The statics are per KV
+     * type, so it cannot run next to a writable table of the same type. */
+    static steph *open_readonly(std::filesystem::path pool_path,
+                                std::filesystem::path kv_path = {}) {
+        auto seg_path = std::filesystem::path{pool_path};
+        seg_path += ".seg";
+        auto main = map_readonly(pool_path);
+        auto seg = map_readonly(seg_path);
+#ifdef VALUE_HEAP
+        /* The records are kept in the main pool */
+        kv_path.clear();
+#endif
+        auto kvs = kv_path.empty() ? main : map_readonly(kv_path);
+
+        Segment<KV>::allocator = (stack_allocator<Segment<KV>> *) seg;
+        segment_ptr<KV>::base = (Segment<KV> *) seg;
+        c_ptr<Directory<KV>>::base = main;
+        c_ptr<Segment<KV>>::base = main;
+        c_ptr<segment_ptr<KV>>::base = main;
+        kv_ptr<KV>::base = kvs;
+        kv_ptr<KV>::readonly = true;
+        auto ret = reinterpret_cast<steph *>(
+                main + Segment<KV>::allocator->root_offset);
+        auto segment_num = readonly_pools[1].second / sizeof(Segment<KV>);
+#ifdef CACHE_HASH
+        segment_hashes<KV>::map(segment_num);
+        ret->rebuild_hashes();
+#endif
+#ifdef BLOOM_FILTER
+        segment_filter<KV>::map(segment_num);
+        ret->rebuild_filters();
+#endif
+        print("table {} opened read-only with depth {}\n", pool_path.c_str(),
+              (size_t) ret->dir->depth);
         return ret;
     }
 
     /* Close the stable hash table */
     static void close(steph *map) {
+        if (!readonly_pools.empty()) {
+            close_readonly();
+            return;
+        }
 #ifndef SINGLE_THREAD
         hidden_worker.stop_work();
+#endif
+        buffered_epochs<KV>::close();
+#ifdef VALUE_HEAP
+        value_heap<KV>::close();
 #endif
         stack_allocator<Segment<KV>>::close(Segment<KV>::allocator);
+#ifdef BLOOM_FILTER
+        segment_filter<KV>::unmap();
+#endif
+#ifdef CACHE_HASH
+        segment_hashes<KV>::unmap();
+#endif
         pm_pool.close();
     }
 
+    static char *map_readonly(std::filesystem::path const &path) {
+        auto fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + path.string());
+        }
+        auto len = std::filesystem::file_size(path);
+        auto addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("cannot map " + path.string());
+        }
+        readonly_pools.emplace_back((char *) addr, len);
+        return (char *) addr;
+    }
+
+    static void close_readonly() {
+#ifdef BLOOM_FILTER
+        segment_filter<KV>::unmap();
+#endif
+#ifdef CACHE_HASH
+        segment_hashes<KV>::unmap();
+#endif
+        for (auto [addr, len] : readonly_pools) { munmap(addr, len); }
+        readonly_pools.clear();
+        c_ptr<Directory<KV>>::base = nullptr;
+        c_ptr<Segment<KV>>::base = nullptr;
+        c_ptr<segment_ptr<KV>>::base = nullptr;
+        kv_ptr<KV>::base = nullptr;
+        kv_ptr<KV>::readonly = false;
+    }
+
     /* Initialize the segment stack allocator */
     static void allocator_init(std::filesystem::path path, size_t pool_size) {
         auto seg_path = std::filesystem::path{path};
@@ -127,6 +278,14 @@ struct steph {
                 stack_allocator<Segment<KV>>::open(seg_path.c_str(), pool_size);
         Segment<KV>::allocator->clear();
         segment_ptr<KV>::base = (Segment<KV> *) Segment<KV>::allocator;
+#ifdef BLOOM_FILTER
+        segment_filter<KV>::map(Segment<KV>::allocator->length /
+                                sizeof(Segment<KV>));
+#endif
+#ifdef CACHE_HASH
+        segment_hashes<KV>::map(Segment<KV>::allocator->length /
+                                sizeof(Segment<KV>));
+#endif
         print("finished init\n");
     }
 
@@ -151,6 +310,15 @@ struct steph {
             kv_ptr<KV>::pool_uuid_lo = d.raw().pool_uuid_lo;
         }
         dir = c_ptr<Directory<KV>>{d.raw().off};
+#ifdef VALUE_HEAP
+        /* The records are kept in the main pool */
+        kv_ptr<KV>::pool_uuid_lo = d.raw().pool_uuid_lo;
+        heap_chunk_capacity = pool_size / VALUE_HEAP_CHUNK_SIZE;
+        pmemobj_zalloc(pm_pool.handle(), &heap_chunks,
+                       heap_chunk_capacity * sizeof(PMEMoid), 0);
+        persist(this, sizeof(*this), flush_kind::METADATA);
+        open_value_heap();
+#endif
 
         print("dir allocated\n");
         dir->initialize(init_depth);
@@ -162,7 +330,231 @@ struct steph {
     }
 
 
+    /* Size an empty table for n keys up front, to skip the doublings and
+     * splits on the way. It must not run with other operations. */
+    bool reserve(size_t n) {
+        auto depth = depth_for(n, Segment<KV>::allocator->capacity());
+        if (depth <= dir->depth) { return true; }
+        if (!is_empty()) {
+            print("reserve: the table is not empty\n");
+            return false;
+        }
+        publish_directory(rebuild_directory(depth, true));
+        print("table reserved for {} keys with depth {}\n", n, depth);
+        return true;
+    }
+
+    /* Build an empty table from unsorted KVs in hash order. The KVs are
+     * partitioned by hash range across threads, and the three segments of
+     * every entry pair are filled in DRAM and streamed to PM with
+     * non-temporal stores. The directory is published once, then the KVs
+     * that do not fit are inserted as usual. A duplicated key is kept once.
+     * It must not run with other operations. */
+    bool bulk_load(
+            std::vector<std::pair<std::string_view, kv_ptr<KV>>> const &kvs,
+            size_t thread_num) {
+        time_guard tg("Bulk load");
+        if (!is_empty()) {
+            print("bulk_load: the table is not empty\n");
+            return false;
+        }
+        thread_num = std::max(1ul, thread_num);
+        size_t depth = std::max(
+                {2ul, (size_t) dir->depth,
+                 depth_for(kvs.size(), Segment<KV>::allocator->capacity())});
+        size_t pair_num = 1ul << (depth - 1);
+        auto pair_of = [&](size_t hash) { return hash >> (65 - depth); };
+        auto owner_of = [&](size_t pair) {
+            return pair * thread_num / pair_num;
+        };
+        auto parallel = [&](auto &&fn) {
+            std::vector<std::thread> th;
+            for (size_t t = 0; t < thread_num; t++) { th.emplace_back(fn, t); }
+            for (auto &t : th) { t.join(); }
+        };
+
+        /* Partition by hash range */
+        size_t n = kvs.size();
+        std::vector<size_t> hashes(n);
+        std::vector<std::vector<size_t>> counts(
+                thread_num, std::vector<size_t>(thread_num, 0));
+        parallel([&](size_t t) {
+            for (size_t i = t * n / thread_num; i < (t + 1) * n / thread_num;
+                 i++) {
+                hashes[i] = std::hash<std::string_view>{}(kvs[i].first);
+                counts[t][owner_of(pair_of(hashes[i]))]++;
+            }
+        });
+        std::vector<size_t> range(thread_num + 1, 0);
+        for (size_t u = 0, pos = 0; u < thread_num; u++) {
+            range[u] = pos;
+            for (size_t t = 0; t < thread_num; t++) {
+                auto cnt = counts[t][u];
+                counts[t][u] = pos;
+                pos += cnt;
+            }
+        }
+        range[thread_num] = n;
+        std::vector<std::pair<size_t, size_t>> parts(n);
+        parallel([&](size_t t) {
+            for (size_t i = t * n / thread_num; i < (t + 1) * n / thread_num;
+                 i++) {
+                parts[counts[t][owner_of(pair_of(hashes[i]))]++] = {hashes[i],
+                                                                     i};
+            }
+        });
+
+        /* Fill the segments pair by pair */
+        auto d = rebuild_directory(depth, false);
+        std::vector<std::vector<size_t>> overflow(thread_num);
+        parallel([&](size_t u) {
+            auto begin = parts.begin() + range[u];
+            auto end = parts.begin() + range[u + 1];
+            std::sort(begin, end);
+            auto buf = std::make_unique<std::array<Segment<KV>, 3>>();
+            auto it = begin;
+            for (size_t pair = (u * pair_num + thread_num - 1) / thread_num;
+                 pair < ((u + 1) * pair_num + thread_num - 1) / thread_num;
+                 pair++) {
+                /* top segment of 2 * pair, shared bottom, top of the other */
+                auto sp = d->cur[2 * pair];
+                Segment<KV> *dst[3] = {sp.get(0), sp.get(1),
+                                       d->cur[2 * pair + 1].get(0)};
+                memset(buf.get(), 0, sizeof(*buf));
+                std::array<std::array<uint8_t, BUCKET_NUM_PER_SEGMENT>, 3>
+                        used{};
+                for (auto run = it; it != end && pair_of(it->first) == pair;
+                     ++it) {
+                    auto [hash, idx] = *it;
+                    auto [k, pkv] = kvs[idx];
+                    /* Duplicates are adjacent with the same hash */
+                    if (run->first != hash) { run = it; }
+                    if (std::any_of(run, it, [&](auto const &e) {
+                            return kvs[e.second].first == k;
+                        })) {
+                        continue;
+                    }
+                    size_t top = (segment_index(hash, depth) & 1) ? 2 : 0;
+                    bool placed = false;
+                    for (auto level : {1, 0}) {
+                        auto bidx = bucket_index(hash, depth, 0, level);
+                        auto seg = level ? 1 : top;
+                        auto &cnt = used[seg][bidx];
+                        if (cnt == KV_NUM_PER_BUCKET) { continue; }
+                        pkv.fingerprint =
+                                fingerprint(hash, depth - level, 0);
+#ifdef CACHE_HASH
+                        cache_hash(dst[seg]->buckets[bidx].slots[cnt], hash);
+#endif
+                        (*buf)[seg].buckets[bidx].slots[cnt++] = pkv;
+#ifdef BLOOM_FILTER
+                        filter_of(d->cur[segment_index(hash, depth)], level,
+                                  bidx)
+                                .add(hash);
+#endif
+                        placed = true;
+                        break;
+                    }
+                    if (!placed) { overflow[u].push_back(idx); }
+                }
+                for (size_t s = 0; s < 3; s++) {
+                    pmem_memcpy(dst[s], &(*buf)[s], sizeof(Segment<KV>),
+                                PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
+                    pmhb_ns::trace_flush(dst[s], sizeof(Segment<KV>),
+                                         flush_kind::SEGMENT);
+                }
+                add_write_counter<KV>(3 * sizeof(Segment<KV>));
+            }
+            pmem_drain();
+        });
+        publish_directory(d);
+
+        /* Insert the KVs of full buckets */
+        parallel([&](size_t u) {
+            for (auto idx : overflow[u]) {
+                insert(kvs[idx].first, {}, kvs[idx].second, true);
+            }
+        });
+        size_t overflow_num = 0;
+        for (auto &o : overflow) { overflow_num += o.size(); }
+        print("bulk loaded {} KVs with depth {}, {} inserted one by one\n", n,
+              depth, overflow_num);
+        return true;
+    }
+
+    /* Whether no key has ever been inserted, since slots are taken in order
+     * and a deleted key leaves a tombstone */
+    bool is_empty() {
+        const auto &d = *(dir.get());
+        if (d.resizing) { return false; }
+        for (size_t i = 0; i < d.capacity; i++) {
+            for (auto level : {0, 1}) {
+                for (auto &bucket : d.cur[i].get(level)->buckets) {
+                    if (bucket.slots[0] != nullptr) { return false; }
+                }
+            }
+        }
+        return true;
+    }
+
     /* Helper functions */
+    /* Drop the segments of an empty table and build a directory of the
+     * given depth, which is not visible before publish_directory() */
+    pmem::obj::persistent_ptr<Directory<KV>>
+    rebuild_directory(size_t depth, bool clear_segments) {
+#ifndef SINGLE_THREAD
+        while (hidden_worker.dir_need_double) {
+            /* waiting for the background end */
+        }
+#endif
+        /* No split has happened, so the segments can be dropped at once */
+        Segment<KV>::allocator->clear();
+#ifdef BLOOM_FILTER
+        segment_filter<KV>::map(Segment<KV>::allocator->capacity());
+#endif
+#ifdef CACHE_HASH
+        segment_hashes<KV>::map(Segment<KV>::allocator->capacity());
+#endif
+        pmem::obj::persistent_ptr<Directory<KV>> d;
+        pmem::obj::transaction::run(pm_pool, [&] {
+            d = pmem::obj::make_persistent<Directory<KV>>();
+        });
+        add_write_counter<KV>(sizeof(Directory<KV>));
+        d->initialize(depth, clear_segments);
+        return d;
+    }
+
+    /* Switch to a rebuilt directory and free the old one */
+    void publish_directory(pmem::obj::persistent_ptr<Directory<KV>> d) {
+        auto old_dir = dir;
+        __atomic_store_n(&dir.offset, d.raw().off, __ATOMIC_SEQ_CST);
+        persist(&dir, sizeof(dir), flush_kind::DIRECTORY);
+        add_write_counter<KV>(sizeof(dir));
+
+        auto uulo = d.raw().pool_uuid_lo;
+        for (auto off : {old_dir->cur.offset, old_dir->next.offset,
+                         old_dir.offset}) {
+            PMEMoid oid{uulo, off};
+            pmemobj_free(&oid);
+        }
+    }
+
+    /* The depth to hold n keys at RESERVE_LOAD_FACTOR, bounded by the half
+     * of the segment pool to leave room for splits */
+    static size_t depth_for(size_t n, size_t segment_capacity) {
+        /* A top segment per entry and a bottom segment per two entries */
+        constexpr size_t slots_per_entry =
+                BUCKET_NUM_PER_SEGMENT * KV_NUM_PER_BUCKET * 3 / 2;
+        size_t depth = 1;
+        while ((slots_per_entry << depth) * RESERVE_LOAD_FACTOR < n) {
+            depth++;
+        }
+        while (depth > 1 && (3ul << depth) / 2 > segment_capacity / 2) {
+            depth--;
+        }
+        return depth;
+    }
+
     inline static size_t segment_index(size_t hash, size_t global_depth) {
         return hash >> (64ul - global_depth);
     }
@@ -198,6 +590,14 @@ struct steph {
 #endif
     }
 
+#ifdef BLOOM_FILTER
+    inline static bucket_filter &filter_of(segment_ptr<KV> sp, size_t level,
+                                           size_t bidx) {
+        return segment_filter<KV>::of(level ? sp.offset1 : sp.offset0)
+                .buckets[bidx];
+    }
+#endif
+
     /* Interfaces */
     KV *search(std::string_view k) {
 #ifdef PMHB_LATENCY
@@ -252,19 +652,101 @@ struct steph {
             //      whole life (since only one key is inserted and it is not available to
             //      other key after it is deleted.)
 
-
+#ifdef BLOOM_FILTER
+            /* Skip the bucket in PM if the key has never been put into it */
+            if (!filter_of(sp, level, bidx[level]).may_contain(hash)) {
+                continue;
+            }
+#endif
             std::tie(ret, first_empty[level], retry) =
                     sp.get(level)->avx_search(
                             k, fp[level],
                             stale_fingerprint(hash, depth, sp.diff),
                             bidx[level]);
 
-            if (retry) { goto search_retry; }
+            if (retry) {
+                stat_counters::count(COPIED_RETRY);
+                goto search_retry;
+            }
             if (ret != nullptr) { return ret; }
         }
         return nullptr;
     }
 
+    /* The search as a coroutine, which prefetches and suspends before the
+     * directory entry, the bucket and the KV, so that a coro::scheduler
+     * overlaps the PM latency of many lookups in one thread.
+     * The key must outlive the task. Not sampled by PMHB_LATENCY, since the
+     * lookups of a thread interleave. */
+    coro::task<KV *> search_async(std::string_view k) {
+        size_t hash = std::hash<std::string_view>{}(k);
+        while (true) {
+            const auto &d = *(dir.get());
+            auto depth = d.depth;
+            co_await coro::prefetch{&d.cur[segment_index(hash, depth)]};
+            auto sp = d.cur[segment_index(hash, depth)];
+            if (sp == nullptr) {
+                depth += 1;
+                sp = d.next[segment_index(hash, depth)];
+                if (sp == nullptr) { continue; }
+            }
+
+            size_t fp[2] = {fingerprint(hash, depth, sp.diff),
+                            fingerprint(hash, depth - 1, sp.diff)};
+            size_t bidx[2] = {bucket_index(hash, depth, sp.diff, 0),
+                              bucket_index(hash, depth, sp.diff, 1)};
+            bool retry = false;
+            for (auto &level : {1, 0}) {
+#ifdef BLOOM_FILTER
+                if (!filter_of(sp, level, bidx[level]).may_contain(hash)) {
+                    continue;
+                }
+#endif
+                auto segment = sp.get(level);
+                auto &bucket = segment->buckets[bidx[level]];
+                co_await coro::prefetch{&bucket, sizeof(bucket)};
+
+                auto [candidates, copied] = segment->avx_candidates(
+                        fp[level], stale_fingerprint(hash, depth, sp.diff),
+                        bidx[level]);
+                if (copied) {
+                    stat_counters::count(COPIED_RETRY);
+                    retry = true;
+                    break;
+                }
+                while (candidates) {
+                    int idx = __builtin_ctz(candidates);
+                    candidates &= candidates - 1;
+                    auto &slot = bucket.slots[idx];
+                    kv_ptr<KV> local_slot = slot;
+                    if (local_slot == nullptr) { continue; }
+                    if (local_slot.is_tombstone()) [[unlikely]] {
+                        if (local_slot.is_volatile()) {
+#ifdef BATCH_PERSIST
+                            bucket.persist_line();
+#else
+                            slot.persist_and_clear();
+#endif
+                        }
+                        continue;
+                    }
+                    co_await coro::prefetch{local_slot.get()};
+                    if (local_slot->key() != k) { continue; }
+                    if (local_slot.is_volatile()) {
+                        /* Clear the dirty bit before the value return */
+#ifdef BATCH_PERSIST
+                        bucket.persist_line();
+#else
+                        slot.persist_and_clear();
+#endif
+                    }
+                    co_return local_slot.get();
+                }
+            }
+            if (!retry) { co_return nullptr; }
+        }
+    }
+
     bool insert(std::string_view k, std::string_view v, kv_ptr<KV> pkv = {},
                 bool is_load = false) {
 #ifdef PMHB_LATENCY
@@ -275,11 +757,17 @@ struct steph {
         time_guard tg("I: ");
 #endif
         size_t hash = std::hash<std::string_view>{}(k);
+        bool first_try = true;
+#ifdef VALUE_HEAP
+        pkv = kv_ptr<KV>{value_heap<KV>::store(k, v), 0, 0, 0};
+#endif
 
         do {
 #ifdef INSERT_DEBUG
             time_guard tg_do("do ", tg);
 #endif
+            if (!first_try) { stat_counters::count(INSERT_RETRY); }
+            first_try = false;
             c_ptr<Directory<KV>> d = dir;
             size_t depth = d->depth;
             bool resizing = false;
@@ -342,6 +830,9 @@ struct steph {
 #ifdef WRITE_KV
                     pmemobj_free(&oid);
 #endif
+#ifdef VALUE_HEAP
+                    value_heap<KV>::release(pkv.offset);
+#endif
 #ifdef TRADITIONAL_LOCK
                     sp.get(0)->buckets[bidx[0]].unlock();
                     sp.get(1)->buckets[bidx[1]].unlock();
@@ -354,6 +845,7 @@ struct steph {
                 sp.get(0)->buckets[bidx[0]].unlock();
                 sp.get(1)->buckets[bidx[1]].unlock();
 #endif
+                stat_counters::count(COPIED_RETRY);
                 continue;
             }
             /* Try to insert */
@@ -363,6 +855,10 @@ struct steph {
                 time_guard tg1("write", tg);
 #endif
                 pkv.fingerprint = fp[level];
+#ifdef BLOOM_FILTER
+                /* Set the bits before the slot is visible to searches */
+                filter_of(sp, level, bidx[level]).add(hash);
+#endif
 #ifdef DEBUG
                 myLOG("\n[INSERT] key:{} (hash:{:016x}), on level: {}, L:{}, "
                       "diff:"
@@ -377,14 +873,16 @@ struct steph {
                     // during the run phase (including load in ycsb load test),
                     //      we insert with dirty flag set.
                     std::tie(ret, retry) = sp.get(level)->insert_from(
-                            first_empty[level], k, fp[level], bidx[level], pkv);
+                            first_empty[level], k, fp[level], bidx[level], pkv,
+                            hash);
                 } else {
                     // during the load phase, we insert without set dirty flag, becaseu
                     //      we assume there is a interval between load phase and run phase
                     //      and the interval is enough for persisting the hash table so that
                     //      the dirty bit is not necessary.
                     std::tie(ret, retry) = sp.get(level)->load(
-                            first_empty[level], k, fp[level], bidx[level], pkv);
+                            first_empty[level], k, fp[level], bidx[level], pkv,
+                            hash);
                 }
                 // ret = sp.get(level)->insert(k, fp[level], bidx[level], pkv);
                 if (retry) { break; }
@@ -418,11 +916,13 @@ struct steph {
 #ifdef INSERT_DEBUG
                 if (!retry) { time_guard tg2("retry(dir changed)", tg); }
 #endif
+                if (retry) { stat_counters::count(COPIED_RETRY); }
                 continue;
             }
             if (resizing && sp.diff == 0) {
                 /* The segment is ahead of the directory doubling, and needs to wait */
                 // exit(0);
+                stat_counters::count(DOUBLING_WAIT);
                 continue;
             }
 
@@ -455,6 +955,8 @@ struct steph {
             std::tie(new_segment0, new_segment1) = lazy_split(
                     sp, depth, bidx[1] & (BUCKET_NUM_PER_SEGMENT >> 1));
 #endif
+                /* The copies are persistent, so are the writes they hold */
+                buffered_epochs<KV>::sync();
                 if (sp.diff == 0) {
                     /* Doubling the directory */
 
@@ -477,8 +979,9 @@ struct steph {
                             d->next[2 * i].diff += 1;
                             d->next[2 * i + 1].diff += 1;
                         }
-                        pmem_persist(d->next.get(),
-                                     d->capacity * 2 * sizeof(segment_ptr<KV>));
+                        persist(d->next.get(),
+                                d->capacity * 2 * sizeof(segment_ptr<KV>),
+                                flush_kind::DIRECTORY);
                         add_write_counter<KV>(d->capacity * 2 *
                                               sizeof(segment_ptr<KV>));
                         pmem::obj::persistent_ptr<Directory<KV>> new_dir;
@@ -495,10 +998,11 @@ struct steph {
                     }
                     d->next[sidx_base * 2].store(new_segment0);
                     d->next[sidx_base * 2 + 1].store(new_segment1);
-                    pmem_persist(&d->next[sidx_base * 2],
-                                 2 * sizeof(segment_ptr<KV>));
+                    persist(&d->next[sidx_base * 2],
+                            2 * sizeof(segment_ptr<KV>), flush_kind::DIRECTORY);
                     d->cur[sidx_base].clear();
-                    pmem_persist(&d->cur[sidx_base], sizeof(segment_ptr<KV>));
+                    persist(&d->cur[sidx_base], sizeof(segment_ptr<KV>),
+                            flush_kind::DIRECTORY);
                     add_write_counter<KV>(3 * sizeof(segment_ptr<KV>));
                 } else {
                     /* Normal split */
@@ -515,15 +1019,19 @@ struct steph {
                                                               ? new_segment0
                                                               : new_segment1);
                     }
-                    pmem_persist(&d_in_use[sidx_base],
-                                 sidx_span * sizeof(segment_ptr<KV>));
+                    persist(&d_in_use[sidx_base],
+                            sidx_span * sizeof(segment_ptr<KV>),
+                            flush_kind::DIRECTORY);
                     for (size_t i = 0; i < sidx_span; i++) {
                         d_in_use[sidx_base + i].unlock();
                     }
-                    pmem_persist(&d_in_use[sidx_base],
-                                 sidx_span * sizeof(segment_ptr<KV>));
+                    persist(&d_in_use[sidx_base],
+                            sidx_span * sizeof(segment_ptr<KV>),
+                            flush_kind::LOCK);
                     add_write_counter<KV>(sidx_span * sizeof(segment_ptr<KV>));
                 }
+            } else {
+                stat_counters::count(SPLIT_LOCK_FAIL);
             }
         } while (true);
 
@@ -539,6 +1047,13 @@ struct steph {
         time_guard tg("U: ");
 #endif
         size_t hash = std::hash<std::string_view>{}(k);
+#ifdef INPLACE_UPDATE
+        if (auto ret = update_inplace(k, v, hash)) { return *ret; }
+#endif
+#ifdef VALUE_HEAP
+        pkv = kv_ptr<KV>{value_heap<KV>::store(k, v), 0, 0, 0};
+#endif
+        kv_ptr<KV> replaced;
 
     update_retry:
 #ifdef UPDATE_DEBUG
@@ -581,15 +1096,31 @@ struct steph {
                   (void *) sp.get(level));
 #endif
 
+#ifdef BLOOM_FILTER
+            if (!filter_of(sp, level, bidx[level]).may_contain(hash)) {
+                continue;
+            }
+#endif
             ret = sp.get(level)->avx_update(
                     k, fp[level], stale_fingerprint(hash, depth, sp.diff),
-                    bidx[level], pkv);
+                    bidx[level], pkv, &replaced);
             // ret = sp.get(level)->update(k, fp[level], bidx[level], pkv);
             // on encountering duplicate key, return a pointer to it
-            if (ret == SUCCESS) { return true; }
-            if (ret == RETRY) { goto update_retry; }
+            if (ret == SUCCESS) {
+#ifdef VALUE_HEAP
+                value_heap<KV>::release(replaced.offset);
+#endif
+                return true;
+            }
+            if (ret == RETRY) {
+                stat_counters::count(COPIED_RETRY);
+                goto update_retry;
+            }
         }
 
+#ifdef VALUE_HEAP
+        value_heap<KV>::release(pkv.offset);
+#endif
         return false;
     }
 
@@ -629,6 +1160,7 @@ struct steph {
         int ret = false;
 
         kv_ptr<KV> pkv(kv_ptr<KV>::TOMB_STONE, 0, 0, 0);
+        kv_ptr<KV> replaced;
 
         /* Try to delete */
         for (auto const &level : std::array{1, 0}) {
@@ -646,16 +1178,53 @@ struct steph {
                   (void *) sp.get(level));
 #endif
 
+#ifdef BLOOM_FILTER
+            if (!filter_of(sp, level, bidx[level]).may_contain(hash)) {
+                continue;
+            }
+#endif
             ret = sp.get(level)->avx_delete(
                     k, fp[level], stale_fingerprint(hash, depth, sp.diff),
-                    bidx[level], pkv);
+                    bidx[level], pkv, &replaced);
             // ret = sp.get(level)->update(k, fp[level], bidx[level], pkv);
             // on encountering duplicate key, return a pointer to it
-            if (ret == SUCCESS) { return true; }
-            if (ret == RETRY) { goto delete_retry; }
+            if (ret == SUCCESS) {
+#ifdef VALUE_HEAP
+                value_heap<KV>::release(replaced.offset);
+#endif
+                return true;
+            }
+            if (ret == RETRY) {
+                stat_counters::count(COPIED_RETRY);
+                goto delete_retry;
+            }
         }
         return false;
     }
+
+#ifndef VALUE_HEAP
+    /* Insert or update the KVs together: after a crash, recover() applies
+     * all of them or none. The batch is persisted once by a descriptor in
+     * the redo log of the thread, and its slots are flushed together at the
+     * end. It is not isolated from the operations of other threads. */
+    bool apply_batch(
+            std::vector<std::pair<std::string_view, kv_ptr<KV>>> const &kvs) {
+        if (kvs.size() > BATCH_MAX_SIZE) {
+            print("apply_batch: more than {} KVs\n", BATCH_MAX_SIZE);
+            return false;
+        }
+        batch_log<KV>::begin(kvs);
+        for (auto const &[k, pkv] : kvs) { upsert(k, pkv); }
+        batch_log<KV>::commit();
+        return true;
+    }
+
+    /* Insert k, or update it if it is present */
+    void upsert(std::string_view k, kv_ptr<KV> pkv) {
+        while (!insert(k, {}, pkv) && !update(k, {}, pkv)) {}
+    }
+#endif
+
     auto lazy_split(segment_ptr<KV> to_split, size_t depth, size_t base) {
 
 #ifdef DEBUG
@@ -688,6 +1257,9 @@ struct steph {
         // memset(&dst_in_cache[0], 0, sizeof(Segment<KV>));
         // memset(&dst_in_cache[1], 0, sizeof(Segment<KV>));
         std::array<Bucket<KV>, 4> dst_in_cache;
+#ifdef CACHE_HASH
+        std::array<std::array<uint64_t, KV_NUM_PER_BUCKET>, 4> hash_in_cache;
+#endif
 
 
         auto [addr0, off0] = Segment<KV>::allocator->alloc();
@@ -700,6 +1272,9 @@ struct steph {
             /* Copy slots from bottom level to new segments */
             for (size_t i = 0; i < BUCKET_NUM_PER_SEGMENT / 2; i++) {
                 memset(&dst_in_cache, 0, sizeof(dst_in_cache));
+#ifdef CACHE_HASH
+                memset(&hash_in_cache, 0, sizeof(hash_in_cache));
+#endif
                 unsigned dst_bidx_base =
                         (i << 2) & (BUCKET_NUM_PER_SEGMENT - 1);
                 unsigned dst_sidx =
@@ -725,10 +1300,19 @@ struct steph {
                     //     continue;
                     // }
                     involved_kv++;
+#ifdef CACHE_HASH
+                    /* Unknown hashes are carried over as 0 */
+                    size_t hash_key = __atomic_load_n(
+                            &segment_hashes<KV>::at(&slot), __ATOMIC_ACQUIRE);
+#endif
                     if (slot.stale && need_update) [[unlikely]] {
                         /* The 16-bit fingerprint runs out, calculate the fingerprint for shunt */
+#ifdef CACHE_HASH
+                        hash_key = hash_of_slot(slot, copied_slot);
+#else
                         std::string_view k = slot->key();
                         size_t hash_key = std::hash<std::string_view>{}(k);
+#endif
                         shunt = (hash_key >> (64 - depth + to_split.diff -
                                               BUCKET_INDEX_BIT_NUM - 2)) &
                                 3;
@@ -756,14 +1340,32 @@ struct steph {
                                (int) slot.copied_flag,
                                (int) copied_slot.fingerprint,
                                (int) copied_slot.copied_flag);
+#endif
+#ifdef CACHE_HASH
+                    hash_in_cache[shunt][slot_cnt[shunt]] = hash_key;
 #endif
                     dst_in_cache[shunt].slots[slot_cnt[shunt]++] = copied_slot;
                 }
 
-                pmem_memcpy_persist(&dst[dst_sidx]->buckets[dst_bidx_base],
-                                    &dst_in_cache, sizeof(dst_in_cache));
-                pmem_persist(&src_segment->buckets[base + i],
-                             sizeof(src_segment->buckets[base + i]));
+                memcpy_persist(&dst[dst_sidx]->buckets[dst_bidx_base],
+                               &dst_in_cache, sizeof(dst_in_cache),
+                               flush_kind::SEGMENT);
+                persist(&src_segment->buckets[base + i],
+                        sizeof(src_segment->buckets[base + i]),
+                        flush_kind::BUCKET);
+#ifdef CACHE_HASH
+                memcpy(&segment_hashes<KV>::of(dst_sidx ? off1 : off0)
+                                .buckets[dst_bidx_base],
+                       &hash_in_cache, sizeof(hash_in_cache));
+#endif
+#ifdef BLOOM_FILTER
+                /* Shunting without rehashing, so the filter is inherited */
+                for (unsigned shunt = 0; shunt < 4; shunt++) {
+                    segment_filter<KV>::of(dst_sidx ? off1 : off0)
+                            .buckets[dst_bidx_base + shunt]
+                            .inherit(filter_of(to_split, 1, base + i));
+                }
+#endif
             }
         }
 #ifdef PMHB_LATENCY
@@ -780,8 +1382,8 @@ struct steph {
 #ifdef SPLIT_DEBUG
             time_guard split_guard_memcpy_persisit("toPM", split_guard);
 #endif
-            // pmem_memcpy_persist(addr0, &dst_in_cache[0], sizeof(Segment<KV>));
-            // pmem_memcpy_persist(addr1, &dst_in_cache[1], sizeof(Segment<KV>));
+            // memcpy_persist(addr0, &dst_in_cache[0], sizeof(Segment<KV>));
+            // memcpy_persist(addr1, &dst_in_cache[1], sizeof(Segment<KV>));
         }
         if (need_update) {
 #ifndef SINGLE_THREAD
@@ -827,6 +1429,9 @@ struct steph {
         // memset(&dst_in_cache[0], 0, sizeof(Segment<KV>));
         // memset(&dst_in_cache[1], 0, sizeof(Segment<KV>));
         std::array<Bucket<KV>, 4> dst_in_cache;
+#ifdef CACHE_HASH
+        std::array<std::array<uint64_t, KV_NUM_PER_BUCKET>, 4> hash_in_cache;
+#endif
 
 
         auto [addr0, off0] = Segment<KV>::allocator->alloc();
@@ -835,6 +1440,9 @@ struct steph {
         /* Copy slots from bottom level to new segments */
         for (size_t i = 0; i < BUCKET_NUM_PER_SEGMENT / 2; i++) {
             memset(&dst_in_cache, 0, sizeof(dst_in_cache));
+#ifdef CACHE_HASH
+            memset(&hash_in_cache, 0, sizeof(hash_in_cache));
+#endif
             unsigned dst_bidx_base = (i << 2) & (BUCKET_NUM_PER_SEGMENT - 1);
             unsigned dst_sidx = (unsigned) (i >= BUCKET_NUM_PER_SEGMENT / 4);
             unsigned slot_cnt[4] = {0, 0, 0, 0};
@@ -852,19 +1460,32 @@ struct steph {
                 }
                 involved_kv++;
                 /* The 16-bit fingerprint runs out, calculate the fingerprint for shunt */
-                std::string_view k = slot->key();
-                size_t hash_key = std::hash<std::string_view>{}(k);
+                size_t hash_key = hash_of_slot(slot);
                 shunt = (hash_key >> (64 - depth + to_split.diff -
                                       BUCKET_INDEX_BIT_NUM - 2)) &
                         3;
                 copied_slot = kv_ptr<KV>{slot.offset, 0, 0, slot.fingerprint};
+#ifdef CACHE_HASH
+                hash_in_cache[shunt][slot_cnt[shunt]] = hash_key;
+#endif
                 dst_in_cache[shunt].slots[slot_cnt[shunt]++] = copied_slot;
+#ifdef BLOOM_FILTER
+                segment_filter<KV>::of(dst_sidx ? off1 : off0)
+                        .buckets[dst_bidx_base + shunt]
+                        .add(hash_key);
+#endif
             }
 
-            pmem_memcpy_persist(&dst[dst_sidx]->buckets[dst_bidx_base],
-                                &dst_in_cache, sizeof(dst_in_cache));
-            pmem_persist(&src_segment->buckets[base + i],
-                         sizeof(src_segment->buckets[base + i]));
+            memcpy_persist(&dst[dst_sidx]->buckets[dst_bidx_base],
+                           &dst_in_cache, sizeof(dst_in_cache),
+                           flush_kind::SEGMENT);
+            persist(&src_segment->buckets[base + i],
+                    sizeof(src_segment->buckets[base + i]), flush_kind::BUCKET);
+#ifdef CACHE_HASH
+            memcpy(&segment_hashes<KV>::of(dst_sidx ? off1 : off0)
+                            .buckets[dst_bidx_base],
+                   &hash_in_cache, sizeof(hash_in_cache));
+#endif
         }
 #ifdef PMHB_LATENCY
         pmhb_ns::sample_guard<steph<KV>, pmhb_ns::RESIZE_ITEM_NUMBER>{
@@ -912,6 +1533,9 @@ struct steph {
         }
 #endif
         std::array<Bucket<KV>, 2> dst_in_cache;
+#ifdef CACHE_HASH
+        std::array<std::array<uint64_t, KV_NUM_PER_BUCKET>, 2> hash_in_cache;
+#endif
 
         /* To tune the performance, use local segment or PM segment directly? */
         auto [addr0, off0] = Segment<KV>::allocator->alloc();
@@ -925,6 +1549,9 @@ struct steph {
         Segment<KV> *src_segment = to_split.get(0);
         for (size_t i = 0; i < BUCKET_NUM_PER_SEGMENT; i++) {
             memset(&dst_in_cache, 0, sizeof(dst_in_cache));
+#ifdef CACHE_HASH
+            memset(&hash_in_cache, 0, sizeof(hash_in_cache));
+#endif
             unsigned slot_cnt[2] = {0, 0};
 
             for (size_t j = 0; j < KV_NUM_PER_BUCKET; j++) {
@@ -943,8 +1570,7 @@ struct steph {
 #endif
                 involved_kv++;
 
-                std::string_view k = slot->key();
-                size_t hash_key = std::hash<std::string_view>{}(k);
+                size_t hash_key = hash_of_slot(slot);
                 // shunt = bucket_index(hash_key, depth, 0, 0) & 1;
 
                 shunt = (hash_key >> (64 - depth + to_split.diff -
@@ -952,19 +1578,43 @@ struct steph {
                         1;
                 // fmt::print("shunt: {}\n", shunt);
                 copied_slot = kv_ptr<KV>{slot.offset, 0, 0, slot.fingerprint};
+#ifdef CACHE_HASH
+                hash_in_cache[shunt][slot_cnt[shunt]] = hash_key;
+#endif
                 dst_in_cache[shunt].slots[slot_cnt[shunt]++] = copied_slot;
+#ifdef BLOOM_FILTER
+                if (i < BUCKET_NUM_PER_SEGMENT / 2) {
+                    segment_filter<KV>::of(off0).buckets[i * 2 + shunt].add(
+                            hash_key);
+                } else {
+                    segment_filter<KV>::of(off1)
+                            .buckets[(i - BUCKET_NUM_PER_SEGMENT / 2) * 2 +
+                                     shunt]
+                            .add(hash_key);
+                }
+#endif
             }
             if (i < BUCKET_NUM_PER_SEGMENT / 2) {
-                pmem_memcpy_persist(&dst[0]->buckets[i * 2], &dst_in_cache,
-                                    sizeof(dst_in_cache));
+                memcpy_persist(&dst[0]->buckets[i * 2], &dst_in_cache,
+                               sizeof(dst_in_cache), flush_kind::SEGMENT);
+#ifdef CACHE_HASH
+                memcpy(&segment_hashes<KV>::of(off0).buckets[i * 2],
+                       &hash_in_cache, sizeof(hash_in_cache));
+#endif
             } else {
-                pmem_memcpy_persist(
+                memcpy_persist(
                         &dst[1]->buckets[(i - BUCKET_NUM_PER_SEGMENT / 2) * 2],
-                        &dst_in_cache, sizeof(dst_in_cache));
+                        &dst_in_cache, sizeof(dst_in_cache),
+                        flush_kind::SEGMENT);
+#ifdef CACHE_HASH
+                memcpy(&segment_hashes<KV>::of(off1)
+                                .buckets[(i - BUCKET_NUM_PER_SEGMENT / 2) * 2],
+                       &hash_in_cache, sizeof(hash_in_cache));
+#endif
             }
 #ifndef TRADITIONAL_LOCK
-            pmem_persist(&src_segment->buckets[i],
-                         sizeof(src_segment->buckets[i]));
+            persist(&src_segment->buckets[i], sizeof(src_segment->buckets[i]),
+                    flush_kind::BUCKET);
 #endif
         }
 
@@ -974,6 +1624,9 @@ struct steph {
         src_segment = to_split.get(1);
         for (size_t i = base; i < base + BUCKET_NUM_PER_SEGMENT / 2; i++) {
             memset(&dst_in_cache, 0, sizeof(dst_in_cache));
+#ifdef CACHE_HASH
+            memset(&hash_in_cache, 0, sizeof(hash_in_cache));
+#endif
             unsigned slot_cnt[2] = {0, 0};
             for (size_t j = 0; j < KV_NUM_PER_BUCKET; j++) {
                 unsigned shunt;
@@ -991,8 +1644,7 @@ struct steph {
 #endif
                 involved_kv++;
 
-                std::string_view k = slot->key();
-                size_t hash_key = std::hash<std::string_view>{}(k);
+                size_t hash_key = hash_of_slot(slot);
                 // shunt = bucket_index(hash_key, depth, 0, 1) & 1;
                 // fmt::print("shunt: {}\n", shunt);
                 shunt = (hash_key >> (64 - depth + to_split.diff -
@@ -1000,13 +1652,25 @@ struct steph {
                         1;
 
                 copied_slot = kv_ptr<KV>{slot.offset, 0, 0, slot.fingerprint};
+#ifdef CACHE_HASH
+                hash_in_cache[shunt][slot_cnt[shunt]] = hash_key;
+#endif
                 dst_in_cache[shunt].slots[slot_cnt[shunt]++] = copied_slot;
+#ifdef BLOOM_FILTER
+                segment_filter<KV>::of(off2)
+                        .buckets[(i - base) * 2 + shunt]
+                        .add(hash_key);
+#endif
             }
-            pmem_memcpy_persist(&dst[2]->buckets[(i - base) * 2], &dst_in_cache,
-                                sizeof(dst_in_cache));
+            memcpy_persist(&dst[2]->buckets[(i - base) * 2], &dst_in_cache,
+                           sizeof(dst_in_cache), flush_kind::SEGMENT);
+#ifdef CACHE_HASH
+            memcpy(&segment_hashes<KV>::of(off2).buckets[(i - base) * 2],
+                   &hash_in_cache, sizeof(hash_in_cache));
+#endif
 #ifndef TRADITIONAL_LOCK
-            pmem_persist(&src_segment->buckets[i],
-                         sizeof(src_segment->buckets[i]));
+            persist(&src_segment->buckets[i], sizeof(src_segment->buckets[i]),
+                    flush_kind::BUCKET);
 #endif
         }
 #ifdef PMHB_LATENCY
@@ -1023,10 +1687,283 @@ struct steph {
     void recover() {
         /* unlock */
         for (size_t i = 0; i < dir->capacity; i++) { dir->cur[i].lck = 0; }
-        pmem_persist(dir->cur.get(), sizeof(dir->cur[0]) * dir->capacity);
+        persist(dir->cur.get(), sizeof(dir->cur[0]) * dir->capacity,
+                flush_kind::LOCK);
         add_write_counter<KV>(sizeof(dir->cur[0]) * dir->capacity);
         /* go ahead with directory double */
         if (dir->resizing) { hidden_worker.submit_flush_dir_request(dir); }
+#ifdef CACHE_HASH
+        rebuild_hashes();
+#endif
+#ifdef BLOOM_FILTER
+        rebuild_filters();
+#endif
+#ifndef VALUE_HEAP
+        batch_log<KV>::roll_forward([&](size_t offset) {
+            kv_ptr<KV> pkv{offset, 0, 0, 0};
+            upsert(pkv->key(), pkv);
+        });
+#endif
+#ifdef VALUE_HEAP
+        /* A key in both a segment of cur and a split one of next is counted
+         * twice, which only delays the cleaning of its chunk */
+        value_heap<KV>::rebuild([&](auto &&live) {
+            for_each_segment([&](Segment<KV> *segment, size_t) {
+                for (auto &bucket : segment->buckets) {
+                    for (auto &slot : bucket.slots) {
+                        kv_ptr<KV> t = slot;
+                        if (t == nullptr) { break; }
+                        if (t.is_tombstone()) { continue; }
+                        live(t.offset);
+                    }
+                }
+            });
+        });
+#endif
+    }
+
+    /* Call fn on every segment referenced by the directory once */
+    template<typename F>
+    size_t for_each_segment(F &&fn) {
+        const auto &d = *(dir.get());
+        std::set<size_t> visited;
+        auto visit = [&](size_t offset) {
+            if (offset == 0 || !visited.insert(offset).second) { return; }
+            fn(segment_ptr<KV>::base + offset, offset);
+        };
+        for (size_t i = 0; i < d.capacity; i++) {
+            visit(d.cur[i].offset0);
+            visit(d.cur[i].offset1);
+        }
+        if (d.resizing) {
+            for (size_t i = 0; i < d.capacity * 2; i++) {
+                visit(d.next[i].offset0);
+                visit(d.next[i].offset1);
+            }
+        }
+        return visited.size();
+    }
+
+    /* Call fn(kv, offset) on every KV whose hash starts with the prefix of
+     * prefix_bits bits, which must not be written meanwhile. A segment shared
+     * with other prefixes is filtered by hash. A slot copied by a split may
+     * be out of date, so its key is searched again, and a KV met in both the
+     * source and the target of a split may be passed twice */
+    template<typename F>
+    void for_each_in_range(size_t prefix, size_t prefix_bits, F &&fn) {
+        auto &d = *(dir.get());
+        size_t depth = d.depth;
+        size_t first = prefix_bits <= depth
+                               ? prefix << (depth - prefix_bits)
+                               : prefix >> (prefix_bits - depth);
+        size_t last = prefix_bits <= depth
+                              ? (prefix + 1) << (depth - prefix_bits)
+                              : first + 1;
+        std::set<size_t> visited;
+        auto visit = [&](size_t offset) {
+            if (offset == 0 || !visited.insert(offset).second) { return; }
+            for (auto &bucket : segment_ptr<KV>::base[offset].buckets) {
+                for (auto &slot : bucket.slots) {
+                    kv_ptr<KV> t = slot;
+                    if (t == nullptr) { break; }
+                    if (t.is_tombstone()) { continue; }
+                    if (hash_of_slot(slot, t) >> (64 - prefix_bits) !=
+                        prefix) {
+                        continue;
+                    }
+                    if (!t.is_copied()) {
+                        fn(t.get(), (size_t) t.offset);
+                    } else if (auto kv = search(t->key())) {
+                        fn(kv, (size_t) pmemobj_oid(kv).off);
+                    }
+                }
+            }
+        };
+        for (size_t i = first; i < last; i++) {
+            auto sp = d.cur.atomic_array_load(i);
+            if (sp == nullptr) {
+                /* The entry has moved to the doubled directory */
+                for (auto j : {2 * i, 2 * i + 1}) {
+                    auto next = d.next.atomic_array_load(j);
+                    visit(next.offset0);
+                    visit(next.offset1);
+                }
+                continue;
+            }
+            visit(sp.offset0);
+            visit(sp.offset1);
+        }
+    }
+
+#ifdef BLOOM_FILTER
+    /* The filters live in DRAM, so they are rebuilt from the segments */
+    void rebuild_filters() {
+        time_guard tg("Rebuild the segment filters");
+        auto n = for_each_segment([](Segment<KV> *segment, size_t offset) {
+            auto &filter = segment_filter<KV>::of(offset);
+            filter.clear();
+            for (size_t i = 0; i < BUCKET_NUM_PER_SEGMENT; i++) {
+                for (auto &slot : segment->buckets[i].slots) {
+                    kv_ptr<KV> t = slot;
+                    if (t == nullptr) { break; }
+                    if (t.is_tombstone()) { continue; }
+                    filter.buckets[i].add(hash_of_slot(slot, t));
+                }
+            }
+        });
+        print("{} segment filters rebuilt\n", n);
+    }
+#endif
+
+#ifdef CACHE_HASH
+    /* The hashes live in DRAM, so they are computed again from the KVs */
+    void rebuild_hashes() {
+        time_guard tg("Rebuild the segment hashes");
+        auto n = for_each_segment([](Segment<KV> *segment, size_t offset) {
+            auto &hashes = segment_hashes<KV>::of(offset);
+            for (size_t i = 0; i < BUCKET_NUM_PER_SEGMENT; i++) {
+                auto &slots = segment->buckets[i].slots;
+                for (size_t j = 0; j < KV_NUM_PER_BUCKET; j++) {
+                    kv_ptr<KV> t = slots[j];
+                    hashes.buckets[i][j] =
+                            t == nullptr || t.is_tombstone()
+                                    ? 0
+                                    : std::hash<std::string_view>{}(t->key());
+                }
+            }
+        });
+        print("{} segment hashes rebuilt\n", n);
+    }
+#endif
+
+    void open_batch_logs() {
+        if (OID_IS_NULL(batch_logs) &&
+            pmemobj_zalloc(pm_pool.handle(), &batch_logs,
+                           BATCH_THREAD_NUM * sizeof(batch_descriptor), 0)) {
+            throw std::runtime_error("cannot allocate the batch logs");
+        }
+        batch_log<KV>::logs = reinterpret_cast<batch_descriptor *>(
+                pmemobj_direct(batch_logs));
+    }
+
+#ifdef VALUE_HEAP
+    void open_value_heap() {
+        value_heap<KV>::open(pm_pool.handle(),
+                             (PMEMoid *) pmemobj_direct(heap_chunks),
+                             heap_chunk_capacity, this);
+    }
+
+    /* The slot holding k, or nullptr */
+    kv_ptr<KV> *find_slot(std::string_view k, size_t hash) {
+        auto d = dir;
+        auto depth = d->depth;
+        auto sp = d->cur[segment_index(hash, depth)];
+        if (sp == nullptr) {
+            depth += 1;
+            sp = d->next[segment_index(hash, depth)];
+        }
+        size_t fp[2] = {fingerprint(hash, depth, sp.diff),
+                        fingerprint(hash, depth - 1, sp.diff)};
+        size_t bidx[2] = {bucket_index(hash, depth, sp.diff, 0),
+                          bucket_index(hash, depth, sp.diff, 1)};
+        for (auto const &level : std::array{1, 0}) {
+#ifdef BLOOM_FILTER
+            if (!filter_of(sp, level, bidx[level]).may_contain(hash)) {
+                continue;
+            }
+#endif
+            if (auto pslot = sp.get(level)->avx_find_slot(
+                        k, fp[level], stale_fingerprint(hash, depth, sp.diff),
+                        bidx[level])) {
+                return pslot;
+            }
+        }
+        return nullptr;
+    }
+
+    /* Point the slot of k at a copy of the record at old_off, for the
+     * cleaner of the value heap. False if the slot has moved on */
+    bool relocate(std::string_view k, size_t old_off) {
+        size_t hash = std::hash<std::string_view>{}(k);
+        size_t new_off = 0;
+        while (true) {
+            auto pslot = find_slot(k, hash);
+            kv_ptr<KV> local_slot{0ul};
+            if (pslot) {
+                local_slot = __atomic_load_n(&pslot->data, __ATOMIC_SEQ_CST);
+            }
+            if (local_slot.is_copied()) {
+                /* Wait for the split to publish the new segments */
+                std::this_thread::yield();
+                continue;
+            }
+            if (pslot == nullptr || local_slot.offset != old_off) {
+                if (new_off) { value_heap<KV>::release(new_off); }
+                return false;
+            }
+            if (new_off == 0) { new_off = value_heap<KV>::copy(old_off); }
+            /* The slot is persisted right away, so no dirty flag is left
+             * for the readers to flush */
+            auto desired = local_slot;
+            desired.offset = new_off;
+            desired.volatile_flag = 0;
+            if (pslot->cas(local_slot.data, desired.data)) {
+                persist(pslot, sizeof(kv_ptr<KV>), flush_kind::SLOT);
+                add_write_counter<KV>(sizeof(kv_ptr<KV>));
+                value_heap<KV>::release(old_off);
+                return true;
+            }
+        }
+    }
+
+#ifdef INPLACE_UPDATE
+    /* Overwrite a small value inside the record of k, without a new record
+     * or a slot swap. Empty if the record has no room for it, so that the
+     * update goes out of place */
+    std::optional<bool> update_inplace(std::string_view k, std::string_view v,
+                                       size_t hash) {
+        if (v.size() > INPLACE_VALUE_SIZE) { return {}; }
+        while (true) {
+            auto pslot = find_slot(k, hash);
+            if (pslot == nullptr) { return false; }
+            kv_ptr<KV> local_slot =
+                    __atomic_load_n(&pslot->data, __ATOMIC_SEQ_CST);
+            if (local_slot.is_copied()) {
+                stat_counters::count(COPIED_RETRY);
+                std::this_thread::yield();
+                continue;
+            }
+            if (local_slot.is_tombstone()) { return false; }
+            /* The new value must not outlive an insert lost in a crash */
+            if (local_slot.is_volatile()) { pslot->persist_and_clear(); }
+            switch (value_heap<KV>::overwrite(local_slot.offset, v)) {
+                case SUCCESS:
+                    return true;
+                case FAIL:
+                    return {};
+                default:
+                    /* Another writer or the cleaner holds the record */
+                    _mm_pause();
+            }
+        }
+    }
+
+    /* The value of a KV returned by search(), which is not in the KV
+     * itself once it is updated in place */
+    static std::string read_value(KV const *kv) {
+        return value_heap<KV>::read_value(kv);
+    }
+#endif
+#endif
+
+    /* Aggregate the internal event counters of all threads */
+    static stats_snapshot stats() {
+        auto ret = stat_counters::snapshot();
+#ifndef SINGLE_THREAD
+        std::tie(ret.refresh_queue_depth, ret.refresh_queue_peak) =
+                hidden_worker.refresh_queue_depth();
+#endif
+        return ret;
     }
 
     size_t get_memory_usage() {
@@ -0,0 +1,517 @@
+#ifndef STEPH_STEPH_U64_HPP
+#define STEPH_STEPH_U64_HPP
+
+#include "alloc.hpp"
+#include "config.hpp"
+#include "stats.hpp"
+#include "util.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <immintrin.h>
+#include <libpmem.h>
+#include <libpmemobj++/pool.hpp>
+#include <libpmemobj.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#if defined PMHB_LATENCY || defined COUNTING_WRITE
+#include "../../include/sample_guard.hpp"
+#endif
+
+namespace steph_ns {
+
+static_assert(U64_PAIR_NUM_PER_BUCKET % 4 == 0, "a bucket is whole lines");
+
+/* An integer key and its value, published together with cmpxchg16b */
+struct alignas(16) u64_pair {
+    /* Data members */
+    uint64_t key;
+    uint64_t value;
+
+    /* The keys are stored shifted to keep 0 and 1 for the empty and the
+     * deleted pairs */
+    inline static constexpr uint64_t EMPTY = 0;
+    inline static constexpr uint64_t TOMB_STONE = 1;
+    inline static constexpr uint64_t KEY_SHIFT = 2;
+    inline static constexpr uint64_t MAX_KEY = UINT64_MAX - KEY_SHIFT;
+
+    /* Interfaces */
+    /* An aligned 16-byte SSE load is atomic on the AVX capable CPUs */
+    u64_pair load() const {
+        auto v = _mm_load_si128(reinterpret_cast<__m128i const *>(this));
+        return {(uint64_t) _mm_cvtsi128_si64(v),
+                (uint64_t) _mm_extract_epi64(v, 1)};
+    }
+
+    bool cas(u64_pair const &expected, u64_pair const &desired) {
+        return __sync_bool_compare_and_swap(
+                reinterpret_cast<unsigned __int128 *>(this), raw(expected),
+                raw(desired));
+    }
+
+    static unsigned __int128 raw(u64_pair const &p) {
+        return (unsigned __int128) p.value << 64 | p.key;
+    }
+};
+
+
+/* Pairs fill a bucket from the front, and the keys of a cache line are
+ * compared with one AVX-512 instruction */
+struct alignas(64) u64_bucket {
+    /* Data members */
+    std::array<u64_pair, U64_PAIR_NUM_PER_BUCKET> pairs;
+
+    /* Interfaces */
+    /* The pair of a stored key, or nullptr and the first empty pair, which
+     * is nullptr as well in a full bucket */
+    std::pair<u64_pair *, u64_pair *> find(uint64_t key) {
+        constexpr __mmask8 key_lanes = 0x55;
+        auto keys = _mm512_set1_epi64(key);
+        auto zeros = _mm512_setzero_si512();
+        for (size_t i = 0; i < U64_PAIR_NUM_PER_BUCKET; i += 4) {
+            auto line = _mm512_load_si512(&pairs[i]);
+            __mmask8 hit = _mm512_mask_cmpeq_epi64_mask(key_lanes, line, keys);
+            if (hit) { return {&pairs[i + __builtin_ctz(hit) / 2], nullptr}; }
+            __mmask8 empty =
+                    _mm512_mask_cmpeq_epi64_mask(key_lanes, line, zeros);
+            if (empty) {
+                return {nullptr, &pairs[i + __builtin_ctz(empty) / 2]};
+            }
+        }
+        return {nullptr, nullptr};
+    }
+};
+
+
+struct alignas(64) u64_segment {
+    /* Data members */
+    size_t local_depth;
+    /* The redo record of a split, the offsets of the two halves */
+    std::array<size_t, 2> split_to;
+    /* The writers in the segment and the split flags, reset by recovery */
+    std::atomic<uint64_t> state;
+    std::array<u64_bucket, U64_BUCKET_NUM_PER_SEGMENT> buckets;
+
+    inline static constexpr uint64_t SPLITTING = 1ul << 62;
+    inline static constexpr uint64_t RETIRED = 1ul << 63;
+
+    /* Interfaces */
+    /* Register a writer, false if the segment is being split */
+    bool enter() {
+        auto s = state.load();
+        do {
+            if (s & (SPLITTING | RETIRED)) { return false; }
+        } while (!state.compare_exchange_weak(s, s + 1));
+        return true;
+    }
+
+    void leave() { state.fetch_sub(1); }
+
+    /* Keep new writers out and wait for the current ones, false if another
+     * thread splits the segment */
+    bool lock_for_split() {
+        auto s = state.load();
+        do {
+            if (s & (SPLITTING | RETIRED)) { return false; }
+        } while (!state.compare_exchange_weak(s, s | SPLITTING));
+        while (state.load() & ~(SPLITTING | RETIRED)) { _mm_pause(); }
+        return true;
+    }
+
+    bool is_retired() const {
+        return state.load(std::memory_order_acquire) & RETIRED;
+    }
+};
+
+
+struct u64_directory {
+    /* Data members */
+    size_t depth;
+
+    /* Interfaces */
+    /* The segment offsets follow the header */
+    size_t *entries() { return reinterpret_cast<size_t *>(this + 1); }
+    size_t capacity() const { return 1ul << depth; }
+
+    static size_t size_of(size_t depth) {
+        return sizeof(u64_directory) + (sizeof(size_t) << depth);
+    }
+};
+
+
+/* SEPH for 8-byte keys and values. The pairs live in the buckets, so a hit
+ * reads one bucket line and no KV record. The buddy bucket (index ^ 1)
+ * takes the keys of a full bucket, and a split moves the pairs of a full
+ * segment into two halves one level deeper. */
+struct steph_u64 {
+    /* Data members */
+    PMEMoid dir;
+    /* A directory being doubled, and the one replaced by the last doubling,
+     * which is freed by the next one */
+    PMEMoid staged_dir;
+    PMEMoid retired_dir;
+    inline static pmem::obj::pool<steph_u64> pm_pool;
+    inline static stack_allocator<u64_segment> *allocator = nullptr;
+    inline static uint64_t pool_uuid_lo = 0;
+    /* Serialize the directory writes of splits and doublings */
+    inline static std::mutex dir_mutex;
+
+    /* Constructors */
+    steph_u64() = delete;
+
+    /* Interfaces */
+    static steph_u64 *open(std::filesystem::path pool_path,
+                           size_t pool_size = DEFAULT_POOL_SIZE,
+                           size_t init_depth = 8) {
+        steph_u64 *ret = nullptr;
+        pool_size /= 2;// for the main pool and the segment pool.
+        auto seg_path = std::filesystem::path{pool_path};
+        seg_path += ".seg";
+        if (std::filesystem::exists(pool_path)) {
+            fmt::print("open: To open the pool\n");
+            pm_pool = pmem::obj::pool<steph_u64>::open(pool_path,
+                                                       SH_U64_POOL_LAYOUT);
+            allocator = stack_allocator<u64_segment>::open(seg_path.c_str(),
+                                                           pool_size, true);
+            pool_uuid_lo = pm_pool.root().raw().pool_uuid_lo;
+            ret = pm_pool.root().get();
+        } else {
+            fmt::print("open: To create the pool\n");
+            pm_pool = pmem::obj::pool<steph_u64>::create(
+                    pool_path, SH_U64_POOL_LAYOUT, pool_size);
+            allocator = stack_allocator<u64_segment>::open(seg_path.c_str(),
+                                                           pool_size);
+            allocator->clear();
+            pool_uuid_lo = pm_pool.root().raw().pool_uuid_lo;
+            ret = pm_pool.root().get();
+            ret->initialize(std::max(init_depth, 1ul));
+        }
+        return ret;
+    }
+
+    static void close(steph_u64 *map) {
+        stack_allocator<u64_segment>::close(allocator);
+        pm_pool.close();
+    }
+
+    void initialize(size_t depth) {
+        if (pmemobj_alloc(pm_pool.handle(), &dir, u64_directory::size_of(depth),
+                          0, nullptr, nullptr)) {
+            throw std::runtime_error("steph_u64: no space for the directory");
+        }
+        staged_dir = retired_dir = OID_NULL;
+        persist(this, sizeof(*this), flush_kind::METADATA);
+        auto d = directory();
+        d->depth = depth;
+        auto [segments, first] = allocator->alloc(d->capacity());
+        memset_persist(segments, 0, d->capacity() * sizeof(u64_segment),
+                       flush_kind::SEGMENT);
+        for (size_t i = 0; i < d->capacity(); i++) {
+            segments[i].local_depth = depth;
+            persist(&segments[i].local_depth, sizeof(size_t),
+                    flush_kind::SEGMENT);
+            d->entries()[i] = first + i;
+        }
+        persist(d, u64_directory::size_of(depth), flush_kind::DIRECTORY);
+        add_write_counter(u64_directory::size_of(depth) +
+                          d->capacity() * sizeof(u64_segment));
+        fmt::print("table inited depth: {}\n", depth);
+    }
+
+    /* Reset the segment states, and finish the interrupted doubling and
+     * splits */
+    void recover() {
+        time_guard tg("Recover steph_u64");
+        if (!OID_IS_NULL(staged_dir)) {
+            if (staged_dir.off == dir.off) {
+                staged_dir = OID_NULL;
+                persist(&staged_dir, sizeof(PMEMoid), flush_kind::METADATA);
+            } else {
+                pmemobj_free(&staged_dir);
+            }
+        }
+        if (retired_dir.off == dir.off) {
+            retired_dir = OID_NULL;
+            persist(&retired_dir, sizeof(PMEMoid), flush_kind::METADATA);
+        }
+        auto d = directory();
+        size_t redone = 0;
+        for (size_t i = 0; i < d->capacity(); i++) {
+            auto seg = segment(d->entries()[i]);
+            if (seg->split_to[0]) {
+                auto side = (i >> (d->depth - seg->local_depth - 1)) & 1;
+                d->entries()[i] = seg->split_to[side];
+                seg = segment(d->entries()[i]);
+                redone++;
+            }
+            seg->state.store(0);
+        }
+        persist(d, u64_directory::size_of(d->depth), flush_kind::DIRECTORY);
+        fmt::print("{} directory entries redone\n", redone);
+    }
+
+    std::optional<uint64_t> search(uint64_t key) {
+#ifdef PMHB_LATENCY
+        auto g = pmhb_ns::sample_guard<steph_u64, pmhb_ns::SEARCH>{};
+#endif
+        if (key > u64_pair::MAX_KEY) [[unlikely]] { return std::nullopt; }
+        auto stored = key + u64_pair::KEY_SHIFT;
+        auto hash = hash_of(key);
+        while (true) {
+            auto seg = locate(hash);
+            std::optional<uint64_t> ret;
+            if (auto p = find(seg, hash, stored)) {
+                auto pair = p->load();
+                if (pair.key == stored) { ret = pair.value; }
+            }
+            /* The writes may have moved on to the halves of a split */
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seg->is_retired()) [[unlikely]] {
+                stat_counters::count(COPIED_RETRY);
+                std::this_thread::yield();
+                continue;
+            }
+            return ret;
+        }
+    }
+
+    bool insert(uint64_t key, uint64_t value) {
+#ifdef PMHB_LATENCY
+        auto g = pmhb_ns::sample_guard<steph_u64, pmhb_ns::INSERT>{};
+#endif
+        if (key > u64_pair::MAX_KEY) [[unlikely]] { return false; }
+        auto pair = u64_pair{key + u64_pair::KEY_SHIFT, value};
+        auto hash = hash_of(key);
+        bool first_try = true;
+        while (true) {
+            if (!first_try) { stat_counters::count(INSERT_RETRY); }
+            first_try = false;
+            auto seg = locate(hash);
+            if (!seg->enter()) {
+                std::this_thread::yield();
+                continue;
+            }
+            auto ret = insert_into(seg, hash, pair);
+            seg->leave();
+            if (ret) { return *ret; }
+            split(seg, hash);
+        }
+    }
+
+    bool update(uint64_t key, uint64_t value) {
+#ifdef PMHB_LATENCY
+        auto g = pmhb_ns::sample_guard<steph_u64, pmhb_ns::UPDATE>{};
+#endif
+        return replace(key, [&](u64_pair const &old) {
+            return u64_pair{old.key, value};
+        });
+    }
+
+    bool Delete(uint64_t key) {
+#ifdef PMHB_LATENCY
+        auto g = pmhb_ns::sample_guard<steph_u64, pmhb_ns::DELETE>{};
+#endif
+        return replace(key, [](u64_pair const &) {
+            return u64_pair{u64_pair::TOMB_STONE, 0};
+        });
+    }
+
+    size_t get_memory_usage() {
+        return allocator->offset * sizeof(u64_segment) +
+               u64_directory::size_of(directory()->depth);
+    }
+
+    static stats_snapshot stats() { return stat_counters::snapshot(); }
+
+    /* Helper functions */
+    static size_t hash_of(uint64_t key) {
+        /* The finalizer of MurmurHash3 */
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdul;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ul;
+        key ^= key >> 33;
+        return key;
+    }
+
+    static size_t bucket_index(size_t hash) {
+        return hash & (U64_BUCKET_NUM_PER_SEGMENT - 1);
+    }
+
+    static u64_segment *segment(size_t offset) {
+        return reinterpret_cast<u64_segment *>(allocator) + offset;
+    }
+
+    static void add_write_counter(size_t size) {
+#if defined(COUNTING_WRITE)
+        pmhb_ns::sample_guard<steph_u64, pmhb_ns::WRITE_COUNT>{size};
+#endif
+    }
+
+    u64_directory *directory() const {
+        return reinterpret_cast<u64_directory *>(pmemobj_direct(
+                {pool_uuid_lo, __atomic_load_n(&dir.off, __ATOMIC_ACQUIRE)}));
+    }
+
+    u64_segment *locate(size_t hash) const {
+        auto d = directory();
+        return segment(__atomic_load_n(&d->entries()[hash >> (64 - d->depth)],
+                                       __ATOMIC_ACQUIRE));
+    }
+
+    /* The pair of a stored key in its bucket or the buddy */
+    static u64_pair *find(u64_segment *seg, size_t hash, uint64_t stored) {
+        auto bidx = bucket_index(hash);
+        auto [p, empty] = seg->buckets[bidx].find(stored);
+        if (p || empty) { return p; }
+        /* A key goes to the buddy only when its own bucket is full */
+        return seg->buckets[bidx ^ 1].find(stored).first;
+    }
+
+    /* True if inserted, false on a duplicate, and nullopt if both buckets
+     * are full */
+    static std::optional<bool> insert_into(u64_segment *seg, size_t hash,
+                                           u64_pair pair) {
+        auto bidx = bucket_index(hash);
+        for (auto b : {bidx, bidx ^ 1}) {
+            auto &bucket = seg->buckets[b];
+            while (true) {
+                auto [p, empty] = bucket.find(pair.key);
+                if (p) { return false; }
+                if (empty == nullptr) { break; }
+                if (empty->cas({u64_pair::EMPTY, 0}, pair)) {
+                    persist(empty, sizeof(u64_pair), flush_kind::SLOT);
+                    add_write_counter(sizeof(u64_pair));
+                    return true;
+                }
+            }
+        }
+        return std::nullopt;
+    }
+
+    /* Swap the pair of a key for make(pair), false if the key is absent */
+    template<typename F>
+    bool replace(uint64_t key, F &&make) {
+        if (key > u64_pair::MAX_KEY) [[unlikely]] { return false; }
+        auto stored = key + u64_pair::KEY_SHIFT;
+        auto hash = hash_of(key);
+        while (true) {
+            auto seg = locate(hash);
+            if (!seg->enter()) {
+                std::this_thread::yield();
+                continue;
+            }
+            bool ret = false;
+            if (auto p = find(seg, hash, stored)) {
+                for (auto old = p->load(); old.key == stored;
+                     old = p->load()) {
+                    if (p->cas(old, make(old))) {
+                        persist(p, sizeof(u64_pair), flush_kind::SLOT);
+                        add_write_counter(sizeof(u64_pair));
+                        ret = true;
+                        break;
+                    }
+                }
+            }
+            seg->leave();
+            return ret;
+        }
+    }
+
+    /* Split a full segment in two, after doubling the directory if the
+     * segment is as deep as it */
+    void split(u64_segment *seg, size_t hash) {
+#ifdef PMHB_LATENCY
+        auto g = pmhb_ns::sample_guard<steph_u64, pmhb_ns::REHASH>{};
+#endif
+        if (!seg->lock_for_split()) {
+            stat_counters::count(SPLIT_LOCK_FAIL);
+            std::this_thread::yield();
+            return;
+        }
+        auto depth = seg->local_depth;
+
+        /* Rehash in DRAM. The keys of a bucket and its buddy fit in the
+         * same two buckets of a half, as a half gets a subset of them */
+        auto halves = std::make_unique<u64_segment[]>(2);
+        std::array<std::array<size_t, U64_BUCKET_NUM_PER_SEGMENT>, 2> fill{};
+        for (auto &bucket : seg->buckets) {
+            for (auto &pair : bucket.pairs) {
+                if (pair.key < u64_pair::KEY_SHIFT) { continue; }
+                auto h = hash_of(pair.key - u64_pair::KEY_SHIFT);
+                auto side = (h >> (63 - depth)) & 1;
+                auto bidx = bucket_index(h);
+                if (fill[side][bidx] == U64_PAIR_NUM_PER_BUCKET) {
+                    bidx ^= 1;
+                }
+                halves[side].buckets[bidx].pairs[fill[side][bidx]++] = pair;
+            }
+        }
+        halves[0].local_depth = halves[1].local_depth = depth + 1;
+        auto [dst, dst_off] = allocator->alloc(2);
+        pmem_memcpy(dst, halves.get(), 2 * sizeof(u64_segment),
+                    PMEM_F_MEM_NONTEMPORAL);
+        pmhb_ns::trace_flush(dst, 2 * sizeof(u64_segment), flush_kind::SEGMENT);
+        add_write_counter(2 * sizeof(u64_segment));
+
+        auto g_dir = std::lock_guard{dir_mutex};
+        auto d = directory();
+        if (depth == d->depth) { d = double_directory(); }
+        /* recover() redoes the directory writes below from here */
+        seg->split_to = {dst_off, dst_off + 1};
+        persist(&seg->split_to, sizeof(seg->split_to), flush_kind::SEGMENT);
+        /* Retire the segment before the halves take writes, so a search
+         * cannot return a value older than the one in a half */
+        seg->state.fetch_or(u64_segment::RETIRED);
+        auto span = 1ul << (d->depth - depth);
+        auto base = (hash >> (64 - d->depth)) & ~(span - 1);
+        for (size_t i = 0; i < span; i++) {
+            __atomic_store_n(&d->entries()[base + i],
+                             dst_off + (i >= span / 2), __ATOMIC_RELEASE);
+        }
+        persist(&d->entries()[base], span * sizeof(size_t),
+                flush_kind::DIRECTORY);
+        add_write_counter(span * sizeof(size_t));
+    }
+
+    /* Called with dir_mutex held. The readers of the retired directory
+     * are assumed to be gone by the next doubling */
+    u64_directory *double_directory() {
+#ifdef PMHB_LATENCY
+        auto g = pmhb_ns::sample_guard<steph_u64, pmhb_ns::DOUBLE>{};
+#endif
+        auto d = directory();
+        if (!OID_IS_NULL(retired_dir)) { pmemobj_free(&retired_dir); }
+        auto size = u64_directory::size_of(d->depth + 1);
+        if (pmemobj_alloc(pm_pool.handle(), &staged_dir, size, 0, nullptr,
+                          nullptr)) {
+            throw std::runtime_error("steph_u64: no space for the directory");
+        }
+        auto next = reinterpret_cast<u64_directory *>(
+                pmemobj_direct(staged_dir));
+        next->depth = d->depth + 1;
+        for (size_t i = 0; i < d->capacity(); i++) {
+            next->entries()[2 * i] = next->entries()[2 * i + 1] =
+                    d->entries()[i];
+        }
+        persist(next, size, flush_kind::DIRECTORY);
+        add_write_counter(size);
+        retired_dir = dir;
+        persist(&retired_dir, sizeof(PMEMoid), flush_kind::METADATA);
+        __atomic_store_n(&dir.off, staged_dir.off, __ATOMIC_RELEASE);
+        persist(&dir, sizeof(PMEMoid), flush_kind::DIRECTORY);
+        staged_dir = OID_NULL;
+        persist(&staged_dir, sizeof(PMEMoid), flush_kind::METADATA);
+        myLOG("DOUBLE DIR towards {}\n", next->depth);
+        return next;
+    }
+};
+
+}// namespace steph_ns
+
+#endif//STEPH_STEPH_U64_HPP
@@ -2,7 +2,10 @@
 #define STEPH_SUBSTRUCTURE_HPP
 
 #include "alloc.hpp"
+#include "batch.hpp"
 #include "config.hpp"
+#include "epoch.hpp"
+#include "hash_cache.hpp"
 #include "util.hpp"
 
 #include <array>
@@ -58,22 +61,25 @@ struct Bucket {
 #ifndef NO_DIRTY_FLAG
         constexpr size_t stride = 8;
         size_t slot_idx_base = slot_idx & (~(stride - 1));
-        pmem_persist(&slots[slot_idx_base], sizeof(kv_ptr<KV>) * stride);
+        persist(&slots[slot_idx_base], sizeof(kv_ptr<KV>) * stride,
+                flush_kind::BUCKET);
 
         for (size_t i = 0; i < stride; i++) {
             auto &slot = slots[slot_idx_base + i];
             if (slot == nullptr) break;
             if (slot.is_volatile()) { slot.clear_dirty_flag(); }
         }
-        pmem_persist(&slots[slot_idx_base], stride * sizeof(kv_ptr<KV>));
+        persist(&slots[slot_idx_base], stride * sizeof(kv_ptr<KV>),
+                flush_kind::BUCKET);
         add_write_counter<KV>(stride * sizeof(kv_ptr<KV>));
 #endif
     }
     void persist_line() {
 #ifndef NO_DIRTY_FLAG
+        stat_counters::count(HELPER_FLUSH);
         Bucket slots_snapshot;
         slots_snapshot.slots = slots;
-        pmem_persist(&slots, sizeof(slots));
+        persist(&slots, sizeof(slots), flush_kind::BUCKET);
         add_write_counter<KV>(sizeof(slots));
 
         for (size_t i = 0; i < KV_NUM_PER_BUCKET; i++) {
@@ -84,7 +90,7 @@ struct Bucket {
                 if (slot.is_volatile()) slot.clear_for(slots_snapshot.slots[i]);
             }
         }
-        pmem_persist(&slots, sizeof(slots));
+        persist(&slots, sizeof(slots), flush_kind::BUCKET);
         add_write_counter<KV>(sizeof(slots));
 #endif
     }
@@ -245,6 +251,45 @@ struct Segment {
         return {nullptr, nullptr, false};
     }
 
+    /* The fingerprint matching of avx_search without touching the KVs, for
+     * the asynchronous search to prefetch a KV before comparing the key */
+    std::pair<uint32_t, bool> avx_candidates(size_t fresh_fingerprint,
+                                             size_t stale_fingerprint,
+                                             size_t bidx) {
+        constexpr size_t summary_mask = 0xffff'8000'0000'0000;
+        auto summary_masks = _mm512_set1_epi64(summary_mask);
+#ifdef ZERO_BREAK
+        auto zero_masks = _mm512_set1_epi64(0);
+#endif
+        auto fresh_fps = _mm512_set1_epi64(fresh_fingerprint << 48);
+        auto stale_fps = _mm512_set1_epi64((stale_fingerprint << 48) |
+                                           0x0000'8000'0000'0000);
+#ifndef TRADITIONAL_LOCK
+        auto copied_masks = _mm512_set1_epi64(kv_ptr<KV>::COPIED_FLAG_MASK);
+#endif
+        uint32_t candidates = 0;
+        for (size_t i = 0; i < KV_NUM_PER_BUCKET; i += 8) {
+            auto slot_v = _mm512_stream_load_si512(&buckets[bidx].slots[i]);
+            auto summary = _mm512_and_epi64(slot_v, summary_masks);
+            uint8_t result = _mm512_cmpeq_epi64_mask(summary, fresh_fps) |
+                             _mm512_cmpeq_epi64_mask(summary, stale_fps);
+#ifndef TRADITIONAL_LOCK
+            if (_mm512_cmpeq_epi64_mask(slot_v, copied_masks)) {
+                return {0, true};
+            }
+#endif
+            candidates |= (uint32_t) result << i;
+#ifdef ZERO_BREAK
+            if (_mm512_cmpeq_epi64_mask(slot_v, zero_masks)) { break; }
+#endif
+        }
+#ifdef TRADITIONAL_LOCK
+        /* The last lane is the bucket lock */
+        candidates &= (1ul << KV_NUM_PER_BUCKET) - 1;
+#endif
+        return {candidates, false};
+    }
+
     kv_ptr<KV> *avx_find_slot(std::string_view k, size_t fresh_fingerprint,
                               size_t stale_fingerprint, size_t bidx) {
 
@@ -302,7 +347,7 @@ struct Segment {
 
     std::pair<bool, bool> insert_from(kv_ptr<KV> *start, std::string_view k,
                                       size_t fingerprint, size_t bidx,
-                                      kv_ptr<KV> &v) {
+                                      kv_ptr<KV> &v, size_t hash) {
         // there is an implementation optimization that the insert can start from
         //      the first non-empty slot (provided in uniqueness check) without affecting correctness.
         //      because of an variant that the skipped slots can never be empty or hold the same
@@ -320,6 +365,7 @@ struct Segment {
 #ifdef CLEAR_IMMIDIATELY
                 slot.clear_dirty_flag();
 #endif
+                cache_hash(slot, hash);
                 return {true, false};
             } else if (slot != nullptr &&
                        slot.authenticate(fingerprint, slot) &&
@@ -338,7 +384,8 @@ struct Segment {
         return {false, false};
     }
     std::pair<bool, bool> load(kv_ptr<KV> *start, std::string_view k,
-                               size_t fingerprint, size_t bidx, kv_ptr<KV> &v) {
+                               size_t fingerprint, size_t bidx, kv_ptr<KV> &v,
+                               size_t hash) {
         if (start == nullptr) { return {false, false}; }
         auto &bucket = buckets[bidx];
 
@@ -352,6 +399,7 @@ struct Segment {
 #ifdef CLEAR_IMMIDIATELY
                 slot.clear_dirty_flag();
 #endif
+                cache_hash(slot, hash);
                 return {true, false};
             } else if (slot != nullptr &&
                        slot.authenticate(fingerprint, slot) &&
@@ -424,8 +472,10 @@ struct Segment {
         }
         return FAIL;
     }
+    /* The slot replaced by a successful write is returned in replaced */
     int avx_update(std::string_view k, size_t fingerprint,
-                   size_t stale_fingerprint, size_t bidx, kv_ptr<KV> &v) {
+                   size_t stale_fingerprint, size_t bidx, kv_ptr<KV> &v,
+                   kv_ptr<KV> *replaced = nullptr) {
         auto pslot = avx_find_slot(k, fingerprint, stale_fingerprint, bidx);
         if (pslot == nullptr) return FAIL;
 
@@ -444,11 +494,15 @@ struct Segment {
             //          local_slot.data & ~kv_ptr<KV>::VOLATILE_FLAG_MASK);
             if (ret) break;
         }
-        if (ret) return SUCCESS;
+        if (ret) {
+            if (replaced) { *replaced = local_slot; }
+            return SUCCESS;
+        }
         return FAIL;
     }
     int avx_delete(std::string_view k, size_t fingerprint,
-                   size_t stale_fingerprint, size_t bidx, kv_ptr<KV> &v) {
+                   size_t stale_fingerprint, size_t bidx, kv_ptr<KV> &v,
+                   kv_ptr<KV> *replaced = nullptr) {
         auto pslot = avx_find_slot(k, fingerprint, stale_fingerprint, bidx);
         if (pslot == nullptr) return FAIL;
 
@@ -467,7 +521,10 @@ struct Segment {
             //            local_slot.data & ~kv_ptr<KV>::VOLATILE_FLAG_MASK);
             if (ret) break;
         }
-        if (ret) return SUCCESS;
+        if (ret) {
+            if (replaced) { *replaced = local_slot; }
+            return SUCCESS;
+        }
 
         return FAIL;
     }
@@ -484,7 +541,7 @@ struct Segment {
                 if (auto t = slot; t != nullptr) {
                     if (t.stale) {
                         // auto hash = std::hash<decltype(t->key())>{}(t->key());
-                        size_t hash = std::hash<std::string_view>{}(t->key());
+                        size_t hash = hash_of_slot(slot, t);
 #ifdef DEBUG
                         if (t->key() == std::string("399063506469976")) {
                             fmt::print("FP update {}, hash: {:016x}, "
@@ -494,10 +551,14 @@ struct Segment {
                                        FP_align);
                         }
 #endif
-                        if (!slot.cas(t.data,
-                                      kv_ptr<KV>{t.offset, 0, 0,
-                                                 (hash >> FP_align) & 0xffffUL}
-                                              .data)) {
+                        kv_ptr<KV> refreshed{t.offset, 0, 0,
+                                             (hash >> FP_align) & 0xffffUL};
+                        /* Logged like a write in an epoch, since it may
+                         * replace one that is rolled back */
+                        if (buffered_epochs<KV>::buffered
+                                    ? !buffered_epochs<KV>::write(
+                                              slot, t.data, refreshed.data)
+                                    : !slot.cas(t.data, refreshed.data)) {
                             // myLOG_fatal("[UPDATE] cas failed\n");
                         }
                     }
@@ -506,11 +567,11 @@ struct Segment {
                 }
             }
             /* To tune the performance, persist the buckets line by line.*/
-            pmem_persist(&bucket, sizeof(bucket));
+            persist(&bucket, sizeof(bucket), flush_kind::BUCKET);
             add_write_counter<KV>(sizeof(bucket));
         }
         // myLOG_DEBUG("update ends {}\n", (this - segment_ptr<KV>::base));
-        // pmem_persist(this, sizeof(Segment));
+        // persist(this, sizeof(Segment));
     }
 };
 
@@ -528,7 +589,9 @@ struct Directory {
     Directory() = default;
 
     /* Interfaces */
-    void initialize(size_t init_depth) {
+    /* The segments are left to the caller to fill if clear_segments is not
+     * set, as the bulk load does */
+    void initialize(size_t init_depth, bool clear_segments = true) {
         depth = init_depth;
         capacity = 1ul << init_depth;
         resizing = false;
@@ -545,22 +608,29 @@ struct Directory {
         add_write_counter<KV>(sizeof(segment_ptr<KV>) * capacity * 3);
 
         fmt::print("alloc segments\n");
-        /* Allocate segments and clear them */
-        for (auto top = 0ul, bottom = 0ul, i = 0ul; i < capacity; ++i) {
-            top = std::get<1>(Segment<KV>::allocator->alloc());
-            if (i % 2 == 0) {
-                bottom = std::get<1>(Segment<KV>::allocator->alloc());
-            }
-            cur[i] = segment_ptr<KV>{top, bottom, 0ul, 0ul};
-            pmem_memset_persist(cur[i].get(0), 0, sizeof(Segment<KV>));
-            add_write_counter<KV>(sizeof(Segment<KV>));
-
+        /* Allocate segments at once and clear them in parallel, a top
+         * segment for each entry and a bottom one for each pair */
+        size_t segment_num = capacity + (capacity + 1) / 2;
+        auto [addr, off] = Segment<KV>::allocator->alloc(segment_num);
+        for (auto top = off, bottom = off, i = 0ul; i < capacity; ++i) {
             if (i % 2 == 0) {
-                pmem_memset_persist(cur[i].get(1), 0, sizeof(Segment<KV>));
-                add_write_counter<KV>(sizeof(Segment<KV>));
+                bottom = top + 1;
+                cur[i] = segment_ptr<KV>{top, bottom, 0ul, 0ul};
+                top += 2;
+            } else {
+                cur[i] = segment_ptr<KV>{top, bottom, 0ul, 0ul};
+                top += 1;
             }
         }
-        pmem_persist(cur.get(), sizeof(segment_ptr<KV>) * capacity);
+        if (clear_segments) {
+            time_guard tg("Memset the initial segments");
+            parallel_memset_persist(addr, segment_num * sizeof(Segment<KV>),
+                                    std::thread::hardware_concurrency(),
+                                    flush_kind::SEGMENT);
+            add_write_counter<KV>(segment_num * sizeof(Segment<KV>));
+        }
+        persist(cur.get(), sizeof(segment_ptr<KV>) * capacity,
+                flush_kind::DIRECTORY);
         add_write_counter<KV>(sizeof(segment_ptr<KV>) * capacity);
 
         fmt::print("directory inited depth: {}\n", depth);
@@ -617,8 +687,8 @@ struct Directory {
                         next[(i + j) * 2].store(next_seg);
                         next[(i + j) * 2 + 1].store(next_seg);
                     }
-                    pmem_persist(&next[i * 2],
-                                 sizeof(segment_ptr<KV>) * span * 2);
+                    persist(&next[i * 2], sizeof(segment_ptr<KV>) * span * 2,
+                            flush_kind::DIRECTORY);
                     for (size_t j = 0; j < span; ++j) { cur[i + j].clear(); }
                     i += span;
                 }
@@ -662,8 +732,8 @@ struct Directory {
     //                     __atomic_store(&next[(i + j) * 2 + 1].data,
     //                                    &next_seg_p.data, __ATOMIC_RELAXED);
     //                 }
-    //                 pmem_persist(next.get() + i * 2,
-    //                              2 * span * sizeof(next[i]));
+    //                 persist(next.get() + i * 2,
+    //                         2 * span * sizeof(next[i]));
     //                 add_write_counter<KV>(2 * span * sizeof(next[i]));
     //                 for (size_t j = 0; j < span; j++) {
     //                     cur[i + j].cas(cur[i + j], segment_ptr<KV>{0, 0, 0, 0});
@@ -695,6 +765,7 @@ struct BG_worker {
     inline static std::mutex mtx_segment, mtx_dir;
     /* TODO: change to persistent queues */
     inline static std::deque<std::pair<Segment<KV> *, size_t>> q_segment;
+    inline static size_t q_segment_peak = 0;
     inline static volatile bool dir_need_double = false;
     inline static c_ptr<Directory<KV>> old_dir;
     inline static std::atomic<bool> stop = 0;
@@ -714,6 +785,13 @@ struct BG_worker {
                                        size_t local_depth) {
         std::lock_guard<std::mutex> lg(mtx_segment);
         q_segment.push_back({target_segment, local_depth});
+        q_segment_peak = std::max(q_segment_peak, q_segment.size());
+    }
+
+    /* The number of segments waiting for the fingerprint refresh */
+    static std::pair<size_t, size_t> refresh_queue_depth() {
+        std::lock_guard<std::mutex> lg(mtx_segment);
+        return {q_segment.size(), q_segment_peak};
     }
 
     static void submit_flush_dir_request(c_ptr<Directory<KV>> in_dir_ptr) {
@@ -747,7 +825,8 @@ struct BG_worker {
                 __atomic_store_n(&map->dir.offset, new_dir.raw().off,
                                  __ATOMIC_SEQ_CST);
 
-                pmem_persist(&map->dir, sizeof(c_ptr<Directory<KV>>));
+                persist(&map->dir, sizeof(c_ptr<Directory<KV>>),
+                        flush_kind::DIRECTORY);
                 add_write_counter<KV>(sizeof(c_ptr<Directory<KV>>));
 
                 dir_need_double = false;
@@ -811,6 +890,10 @@ struct kv_ptr {
         };
     };
     inline static size_t pool_uuid_lo;
+    /* The pool mapped without libpmemobj by a read-only open */
+    inline static char *base = nullptr;
+    /* A read-only table leaves the dirty slots to the writer */
+    inline static bool readonly = false;
     // inline static uintptr_t pop;
     inline static constexpr size_t TOMB_STONE = (1ul << 45) - 1;
     inline static constexpr size_t COPIED_FLAG_MASK = 1ul << 45;
@@ -850,19 +933,35 @@ struct kv_ptr {
             exit(0);
         }
 #endif
+        if (base) [[unlikely]] {
+            return reinterpret_cast<pointer>(base + offset);
+        }
         return reinterpret_cast<pointer>(
                 pmemobj_direct({pool_uuid_lo, offset}));
         // return reinterpret_cast<pointer>(pop + offset);
     }
 
     bool try_write(const kv_ptr &expected, const kv_ptr &desired) {
+        if (batch_log<KV>::applying) {
+            /* Persistent through the descriptor of the batch */
+            return batch_log<KV>::write(
+                    *this, expected.data & ~COPIED_FLAG_MASK, desired.data);
+        }
+        if (buffered_epochs<KV>::buffered) {
+            /* Flushed at the end of the epoch, not by the readers */
+            return buffered_epochs<KV>::write(
+                    *this, expected.data & ~COPIED_FLAG_MASK, desired.data);
+        }
 #ifdef NO_DIRTY_FLAG
         bool ret = cas((expected.data & ~COPIED_FLAG_MASK), desired.data);
 #else
+        /* Nothing is left to flush for the readers in the eADR domain */
         bool ret = cas((expected.data & ~COPIED_FLAG_MASK),
-                       desired.data | VOLATILE_FLAG_MASK);
+                       persistence_domain::eadr
+                               ? desired.data
+                               : desired.data | VOLATILE_FLAG_MASK);
 #endif
-        pmem_persist(this, sizeof(kv_ptr<KV>));
+        persist(this, sizeof(kv_ptr<KV>), flush_kind::SLOT);
 #if defined(COUNTING_WRITE)
         pmhb_ns::sample_guard<steph<KV>, pmhb_ns::WRITE_COUNT>(
                 sizeof(kv_ptr<KV>));
@@ -873,7 +972,7 @@ struct kv_ptr {
 #ifdef NO_DIRTY_FLAG
         return 0;
 #else
-        return volatile_flag;
+        return volatile_flag && !readonly;
 #endif
     }
     bool is_tombstone() { return offset == TOMB_STONE; }
@@ -892,7 +991,7 @@ struct kv_ptr {
     void clear_dirty_flag() {
 #ifndef NO_DIRTY_FLAG
         cas(this->data, this->data & ~VOLATILE_FLAG_MASK);
-        // pmem_persist(this, 8);
+        // persist(this, 8);
 #endif
     }
 
@@ -904,7 +1003,8 @@ struct kv_ptr {
 
     void persist_and_clear() {
 #ifndef NO_DIRTY_FLAG
-        pmem_persist(this, sizeof(kv_ptr<KV>));
+        stat_counters::count(HELPER_FLUSH);
+        persist(this, sizeof(kv_ptr<KV>), flush_kind::SLOT);
         cas(this->data, this->data & ~VOLATILE_FLAG_MASK);
 #endif
     }
@@ -1045,6 +1145,8 @@ struct c_ptr {
     /* Data members */
     size_t offset{};
     inline static size_t pool_uuid_lo;
+    /* The pool mapped without libpmemobj by a read-only open */
+    inline static char *base = nullptr;
 
     /* Constructors */
     c_ptr() = default;
@@ -1060,6 +1162,9 @@ struct c_ptr {
             exit(0);
         }
 #endif
+        if (base) [[unlikely]] {
+            return reinterpret_cast<pointer>(base + offset);
+        }
         return reinterpret_cast<pointer>(
                 pmemobj_direct({pool_uuid_lo, offset}));
     }
@@ -4,8 +4,14 @@
 #include <cstdarg>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
+#include <algorithm>
+#include <libpmem.h>
 #include <sched.h>
 #include <string_view>
+#include <thread>
+#include <vector>
+
+#include "persist.hpp"
 
 #if defined PMHB_LATENCY || defined COUNTING_WRITE
 #include "../../include/sample_guard.hpp"
@@ -89,6 +95,25 @@ void pre_fault(void *pm, size_t len, size_t granularity = 2ul << 20) {
     return;
 }
 
+/* Zero and persist a large PM range with several threads */
+void parallel_memset_persist(void *pm, size_t len, size_t thread_num,
+                             flush_kind kind = flush_kind::OTHER) {
+    pmhb_ns::trace_flush(pm, len, kind);
+    thread_num = std::max(1ul, std::min(thread_num, len >> 20));
+    auto base = (unsigned char *) pm;
+    /* Split at cache line boundaries */
+    size_t chunk = ((len / thread_num) + 63) & ~63ul;
+    std::vector<std::thread> th;
+    for (size_t off = 0; off < len; off += chunk) {
+        th.emplace_back([=] {
+            pmem_memset(base + off, 0, std::min(chunk, len - off),
+                        PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
+        });
+    }
+    for (auto &t : th) { t.join(); }
+    pmem_drain();
+}
+
 struct time_guard {
     // #ifdef DEBUG
     Timer t;
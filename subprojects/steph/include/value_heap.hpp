@@ -0,0 +1,416 @@
+#ifndef STEPH_VALUE_HEAP_HPP
+#define STEPH_VALUE_HEAP_HPP
+
+#include "config.hpp"
+#include "stats.hpp"
+#include "substructure.hpp"
+#include "util.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <immintrin.h>
+#include <libpmem.h>
+#include <libpmemobj.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace steph_ns {
+
+template<typename KV>
+struct steph;
+
+/* The header in front of every KV record in the value heap */
+struct record_header {
+    uint32_t size; // of the header and the KV, 8-byte aligned
+    uint32_t chunk;// index of the chunk holding the record
+#ifdef INPLACE_UPDATE
+    /* 0 if the record has no in-place value slot, otherwise bumped by every
+     * overwrite with the live copy of the slot in the low bit */
+    uint64_t version;
+#endif
+};
+
+
+/* A log-structured PM heap of KV records (VALUE_HEAP). Every thread appends
+ * records to its own chunk, the live bytes of each chunk are counted in
+ * DRAM, and a background cleaner moves the live records out of sparse
+ * chunks by CASing their slots. A KV returned by the table stays readable
+ * for VALUE_HEAP_GRACE_PERIOD_US after it is replaced. */
+template<typename KV>
+struct value_heap {
+    /* Types */
+    enum chunk_state : int { FREE, ACTIVE, CLOSED, CLEANING, LIMBO };
+    using clock = std::chrono::steady_clock;
+
+    struct chunk_info {
+        char *addr = nullptr;
+        size_t offset = 0;
+        std::atomic<int64_t> live{0};
+        std::atomic<int> state{FREE};
+        size_t tail = 0;
+        clock::time_point freed_at;
+    };
+
+    /* The chunk a thread appends to */
+    struct cursor {
+        size_t generation = 0;
+        size_t chunk = 0;
+        size_t pos = 0;
+        ~cursor() {
+            if (generation && generation == value_heap::generation) {
+                close_chunk(*this);
+            }
+        }
+    };
+
+#ifdef INPLACE_UPDATE
+    /* Set in the version while the slot is written or the record is moved */
+    static constexpr uint64_t VERSION_BUSY = 1ul << 63;
+#endif
+
+    /* Data members */
+    inline static PMEMobjpool *pop = nullptr;
+    inline static uint64_t uuid_lo = 0;
+    inline static PMEMoid *table = nullptr;
+    inline static size_t capacity = 0;
+    inline static size_t chunk_num = 0;
+    inline static std::unique_ptr<chunk_info[]> chunks;
+    inline static std::mutex mtx;
+    inline static std::deque<size_t> free_chunks, limbo;
+    inline static size_t generation = 0;
+    inline static thread_local cursor local;
+    inline static std::thread *cleaner = nullptr;
+    inline static std::atomic<bool> stop = false;
+    inline static steph<KV> *map = nullptr;
+
+    /* Interfaces */
+    /* Attach the chunk table of a pool. The liveness of the chunks of an
+     * existing heap is unknown until rebuild(), so the cleaner starts there */
+    static void open(PMEMobjpool *in_pop, PMEMoid *in_table,
+                     size_t in_capacity, steph<KV> *in_map) {
+        pop = in_pop;
+        uuid_lo = pmemobj_oid(in_table).pool_uuid_lo;
+        table = in_table;
+        capacity = in_capacity;
+        map = in_map;
+        chunks = std::make_unique<chunk_info[]>(capacity);
+        free_chunks.clear();
+        limbo.clear();
+        generation++;
+        for (chunk_num = 0;
+             chunk_num < capacity && !OID_IS_NULL(table[chunk_num]);
+             chunk_num++) {
+            auto &c = chunks[chunk_num];
+            c.addr = (char *) pmemobj_direct(table[chunk_num]);
+            c.offset = table[chunk_num].off;
+            c.state = CLOSED;
+            c.live = VALUE_HEAP_CHUNK_SIZE;
+            c.tail = 0;
+        }
+        fmt::print("value heap opened with {} chunks of {}\n", chunk_num,
+                   capacity);
+        if (chunk_num == 0) { start_cleaner(); }
+    }
+
+    static void close() {
+        if (cleaner) {
+            stop = true;
+            cleaner->join();
+            delete cleaner;
+            cleaner = nullptr;
+        }
+        generation++;
+        chunks.reset();
+    }
+
+    /* Append a record of the KV and return its offset in the pool */
+    static size_t store(std::string_view k, std::string_view v) {
+        size_t key_size = k.size() + 1, value_size = v.size() + 1;
+        size_t size = (sizeof(record_header) + sizeof(KV) + key_size +
+                       value_size + 7) &
+                      ~7ul;
+#ifdef INPLACE_UPDATE
+        /* A small value gets two copies at the end of the record */
+        bool inplace = v.size() <= INPLACE_VALUE_SIZE;
+        if (inplace) { size += 2 * INPLACE_VALUE_SIZE; }
+#endif
+        auto [addr, off] = reserve(size);
+        new (addr + sizeof(record_header)) KV(key_size, k, value_size, v);
+#ifdef INPLACE_UPDATE
+        auto h = (record_header *) addr;
+        h->version = 0;
+        if (inplace) {
+            auto values = inplace_values(h);
+            memset(values, 0, 2 * INPLACE_VALUE_SIZE);
+            memcpy(values, v.data(), v.size());
+            h->version = 2;
+        }
+#endif
+        persist(addr, size, flush_kind::RECORD);
+        add_write_counter<KV>(size);
+        return off;
+    }
+
+    /* Copy a record for the cleaner */
+    static size_t copy(size_t offset) {
+        auto h = header_of(offset);
+#ifdef INPLACE_UPDATE
+        /* Keep the in-place writers out of the old record for good, they
+         * find the copy once the slot points to it */
+        auto ver = __atomic_load_n(&h->version, __ATOMIC_ACQUIRE);
+        while (ver && ((ver & VERSION_BUSY) ||
+                       !__atomic_compare_exchange_n(
+                               &h->version, &ver, ver | VERSION_BUSY, false,
+                               __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))) {
+            _mm_pause();
+            ver = __atomic_load_n(&h->version, __ATOMIC_ACQUIRE);
+        }
+#endif
+        auto [addr, off] = reserve(h->size);
+        auto chunk = ((record_header *) addr)->chunk;
+        memcpy(addr, h, h->size);
+        ((record_header *) addr)->chunk = chunk;
+#ifdef INPLACE_UPDATE
+        ((record_header *) addr)->version = ver;
+#endif
+        persist(addr, h->size, flush_kind::RECORD);
+        add_write_counter<KV>(h->size);
+        return off;
+    }
+
+#ifdef INPLACE_UPDATE
+    /* Write a small value to the spare copy of the slot of a record and
+     * switch to it. FAIL if the record has no slot, RETRY if it is busy */
+    static int overwrite(size_t offset, std::string_view v) {
+        auto h = header_of(offset);
+        auto ver = __atomic_load_n(&h->version, __ATOMIC_ACQUIRE);
+        if (ver == 0 || v.size() > INPLACE_VALUE_SIZE) { return FAIL; }
+        if ((ver & VERSION_BUSY) ||
+            !__atomic_compare_exchange_n(&h->version, &ver, ver | VERSION_BUSY,
+                                         false, __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+            return RETRY;
+        }
+        auto spare = inplace_values(h) + ((ver + 1) & 1) * INPLACE_VALUE_SIZE;
+        memset(spare, 0, INPLACE_VALUE_SIZE);
+        memcpy(spare, v.data(), v.size());
+        persist(spare, INPLACE_VALUE_SIZE, flush_kind::RECORD);
+        /* The 8-byte version commits the value */
+        __atomic_store_n(&h->version, ver + 1, __ATOMIC_RELEASE);
+        persist(&h->version, sizeof(h->version), flush_kind::RECORD);
+        add_write_counter<KV>(INPLACE_VALUE_SIZE + sizeof(h->version));
+        return SUCCESS;
+    }
+
+    /* The value of a KV in the heap, read like a seqlock */
+    static std::string read_value(KV const *kv) {
+        auto h = const_cast<record_header *>(
+                reinterpret_cast<record_header const *>(kv) - 1);
+        while (true) {
+            auto ver = __atomic_load_n(&h->version, __ATOMIC_ACQUIRE) &
+                       ~VERSION_BUSY;
+            if (ver == 0) { return kv->value(); }
+            char value[INPLACE_VALUE_SIZE];
+            memcpy(value, inplace_values(h) + (ver & 1) * INPLACE_VALUE_SIZE,
+                   INPLACE_VALUE_SIZE);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((__atomic_load_n(&h->version, __ATOMIC_ACQUIRE) &
+                 ~VERSION_BUSY) == ver) {
+                return {value, strnlen(value, INPLACE_VALUE_SIZE)};
+            }
+        }
+    }
+#endif
+
+    /* A record is no longer referenced by the table */
+    static void release(size_t offset) {
+        auto h = header_of(offset);
+        chunks[h->chunk].live.fetch_sub(h->size, std::memory_order_relaxed);
+    }
+
+    /* Count the live bytes again from the offsets of all records in the
+     * table, and reclaim the chunks without any */
+    template<typename F>
+    static void rebuild(F &&for_each_offset) {
+        time_guard tg("Rebuild the value heap liveness");
+        for (size_t i = 0; i < chunk_num; i++) {
+            chunks[i].live = 0;
+            chunks[i].tail = 0;
+        }
+        for_each_offset([&](size_t offset) {
+            auto h = header_of(offset);
+            if (h->chunk >= chunk_num) { return; }
+            auto &c = chunks[h->chunk];
+#ifdef INPLACE_UPDATE
+            /* A writer or a move cut off by the crash */
+            h->version &= ~VERSION_BUSY;
+#endif
+            c.live += h->size;
+            c.tail = std::max(c.tail, offset - c.offset -
+                                              sizeof(record_header) + h->size);
+        });
+        auto g = std::lock_guard{mtx};
+        free_chunks.clear();
+        size_t live_chunk_num = 0;
+        for (size_t i = 0; i < chunk_num; i++) {
+            if (chunks[i].state != CLOSED) { continue; }
+            if (chunks[i].live) {
+                live_chunk_num++;
+            } else {
+                chunks[i].state = FREE;
+                free_chunks.push_back(i);
+            }
+        }
+        fmt::print("value heap: {} chunks in use, {} free\n", live_chunk_num,
+                   free_chunks.size());
+        if (cleaner == nullptr) { start_cleaner(); }
+    }
+
+    /* Helper functions */
+    static record_header *header_of(size_t offset) {
+        return reinterpret_cast<record_header *>(
+                       pmemobj_direct({uuid_lo, offset})) -
+               1;
+    }
+
+#ifdef INPLACE_UPDATE
+    static char *inplace_values(record_header *h) {
+        return (char *) h + h->size - 2 * INPLACE_VALUE_SIZE;
+    }
+#endif
+
+    static void start_cleaner() {
+        stop = false;
+        cleaner = new std::thread(clean);
+    }
+
+    static std::pair<char *, size_t> reserve(size_t size) {
+        auto &l = local;
+        if (l.generation != generation ||
+            l.pos + size > VALUE_HEAP_CHUNK_SIZE) {
+            if (l.generation == generation) { close_chunk(l); }
+            l.chunk = acquire_chunk();
+            l.pos = 0;
+            l.generation = generation;
+        }
+        auto &c = chunks[l.chunk];
+        auto addr = c.addr + l.pos;
+        ((record_header *) addr)->size = size;
+        ((record_header *) addr)->chunk = l.chunk;
+        l.pos += size;
+        c.live.fetch_add(size, std::memory_order_relaxed);
+        return {addr, c.offset + (addr - c.addr) + sizeof(record_header)};
+    }
+
+    static void close_chunk(cursor &l) {
+        auto &c = chunks[l.chunk];
+        c.tail = l.pos;
+        c.state.store(CLOSED, std::memory_order_release);
+    }
+
+    static size_t acquire_chunk() {
+        auto start = clock::now();
+        while (true) {
+            {
+                auto g = std::lock_guard{mtx};
+                promote_limbo();
+                if (!free_chunks.empty()) {
+                    auto i = free_chunks.front();
+                    free_chunks.pop_front();
+                    /* Late releases of the old records are dropped */
+                    chunks[i].live = 0;
+                    chunks[i].state = ACTIVE;
+                    return i;
+                }
+                if (chunk_num < capacity &&
+                    pmemobj_alloc(pop, &table[chunk_num],
+                                  VALUE_HEAP_CHUNK_SIZE, 0, nullptr,
+                                  nullptr) == 0) {
+                    auto i = chunk_num++;
+                    chunks[i].addr = (char *) pmemobj_direct(table[i]);
+                    chunks[i].offset = table[i].off;
+                    chunks[i].live = 0;
+                    chunks[i].state = ACTIVE;
+                    return i;
+                }
+            }
+            /* Wait for the cleaner */
+            if (clock::now() - start > std::chrono::seconds(10)) {
+                throw std::runtime_error("the value heap is out of space");
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    /* Called with mtx held */
+    static void promote_limbo() {
+        auto now = clock::now();
+        while (!limbo.empty() &&
+               now - chunks[limbo.front()].freed_at >
+                       std::chrono::microseconds(VALUE_HEAP_GRACE_PERIOD_US)) {
+            chunks[limbo.front()].state = FREE;
+            free_chunks.push_back(limbo.front());
+            limbo.pop_front();
+        }
+    }
+
+    /* The background cleaner */
+    static void clean() {
+        while (!stop.load()) {
+            size_t n;
+            {
+                auto g = std::lock_guard{mtx};
+                promote_limbo();
+                n = chunk_num;
+            }
+            /* Pick the sparsest closed chunk */
+            size_t victim = n;
+            int64_t least = VALUE_HEAP_CHUNK_SIZE * VALUE_HEAP_CLEAN_RATIO;
+            for (size_t i = 0; i < n; i++) {
+                if (chunks[i].state.load(std::memory_order_acquire) ==
+                            CLOSED &&
+                    chunks[i].live < least) {
+                    victim = i;
+                    least = chunks[i].live;
+                }
+            }
+            int expected = CLOSED;
+            if (victim == n ||
+                !chunks[victim].state.compare_exchange_strong(expected,
+                                                              CLEANING)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            clean_chunk(victim);
+        }
+    }
+
+    static void clean_chunk(size_t i) {
+        auto &c = chunks[i];
+        for (size_t pos = 0; pos < c.tail && c.live > 0;) {
+            auto h = (record_header *) (c.addr + pos);
+            if (h->size == 0) { break; }
+            auto offset = c.offset + pos + sizeof(record_header);
+            auto kv = (KV *) (h + 1);
+            if (map->relocate(kv->key(), offset)) {
+                stat_counters::count(RECORD_RELOCATE);
+            }
+            pos += h->size;
+        }
+        auto g = std::lock_guard{mtx};
+        c.freed_at = clock::now();
+        c.state = LIMBO;
+        limbo.push_back(i);
+        stat_counters::count(CHUNK_RECLAIM);
+    }
+};
+
+}// namespace steph_ns
+
+#endif//STEPH_VALUE_HEAP_HPP